@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <stdexcept>
 #include <tinyxml2.h>
@@ -28,6 +29,32 @@ struct MeshData {
     TopologyData topology;
 };
 
+// 一次 Load 读的几个数据集共享 HDF5 文件句柄：每个 .h5 文件只打开一次（几何和拓扑通常在同一个文件里）
+class Hdf5HandlePool {
+public:
+    Hdf5HandlePool() = default;
+    Hdf5HandlePool(const Hdf5HandlePool&) = delete;
+    Hdf5HandlePool& operator=(const Hdf5HandlePool&) = delete;
+    ~Hdf5HandlePool() { Close(); }
+
+    // 打开失败返回负值
+    hid_t OpenFile(const std::string& filename) {
+        auto it = files.find(filename);
+        if (it != files.end()) return it->second;
+        hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file >= 0) files.emplace(filename, file);
+        return file;
+    }
+
+    void Close() {
+        for (auto& [name, file] : files) H5Fclose(file);
+        files.clear();
+    }
+
+private:
+    std::unordered_map<std::string, hid_t> files;
+};
+
 // XdmfMeshLoader 类
 class XdmfMeshLoader {
 public:
@@ -35,22 +62,31 @@ public:
 
     const MeshData& GetMeshData() const { return mesh; }
 
-    std::vector<double> ReadGeometryData() const;
-    std::vector<uint64_t> ReadTopologyData() const;
+    // Load 成功后读好的几何坐标和拓扑索引
+    const std::vector<double>& ReadGeometryData() const { return points; }
+    const std::vector<uint64_t>& ReadTopologyData() const { return indices; }
 
 private:
     MeshData mesh;
+    std::vector<double> points;
+    std::vector<uint64_t> indices;
 
     static bool ParseDataItem(tinyxml2::XMLElement* dataItemElem, std::string& out_path, int& out_dim0, int& out_dim1);
 
-    static std::pair<std::string, std::string> ParseHDF5Path(const std::string& full_path);
+    static bool ParseHDF5Path(const std::string& full_path, std::string& filename, std::string& dataset);
+
+    Hdf5HandlePool h5_pool;
 
-    static std::vector<double> ReadPoints(const std::string& filename, const std::string& dataset, int num_points, int dim);
-    static std::vector<uint64_t> ReadIndices(const std::string& filename, const std::string& dataset, int num_elements, int nodes_per_element);
+    bool ReadPoints(const std::string& full_path, int num_points, int dim);
+    bool ReadIndices(const std::string& full_path, int num_elements, int nodes_per_element);
+    bool ReadDataset(const std::string& full_path, hid_t mem_type, void* dest);
 };
 
 // 读取并解析 XDMF 文件
 bool XdmfMeshLoader::Load(const std::string& xdmf_filename) {
+    points.clear();
+    indices.clear();
+
     tinyxml2::XMLDocument doc;
     if (doc.LoadFile(xdmf_filename.c_str()) != tinyxml2::XML_SUCCESS) {
         std::cerr << "Failed to load XML file\n";
@@ -105,7 +141,12 @@ bool XdmfMeshLoader::Load(const std::string& xdmf_filename) {
     }
 
     mesh.topology = {topo_path, num_elements, nodes_per_element};
-    return true;
+
+    // 两个数据集共用一次打开的文件，读完就关
+    bool ok = ReadPoints(mesh.geometry.hdf5_path, mesh.geometry.num_points, mesh.geometry.dim) &&
+              ReadIndices(mesh.topology.hdf5_path, mesh.topology.num_elements, mesh.topology.nodes_per_element);
+    h5_pool.Close();
+    return ok;
 }
 
 bool XdmfMeshLoader::ParseDataItem(tinyxml2::XMLElement* dataItemElem, std::string& out_path, int& out_dim0, int& out_dim1) {
@@ -136,40 +177,48 @@ bool XdmfMeshLoader::ParseDataItem(tinyxml2::XMLElement* dataItemElem, std::stri
     return true;
 }
 
-std::pair<std::string, std::string> XdmfMeshLoader::ParseHDF5Path(const std::string& full_path) {
+bool XdmfMeshLoader::ParseHDF5Path(const std::string& full_path, std::string& filename, std::string& dataset) {
     size_t pos = full_path.find(":");
-    if (pos == std::string::npos) throw std::runtime_error("Invalid HDF5 path: " + full_path);
-    return {full_path.substr(0, pos), full_path.substr(pos + 1)};
+    if (pos == std::string::npos) {
+        std::cerr << "Invalid HDF5 path: " << full_path << "\n";
+        return false;
+    }
+    filename = full_path.substr(0, pos);
+    dataset = full_path.substr(pos + 1);
+    return true;
 }
 
-std::vector<double> XdmfMeshLoader::ReadPoints(const std::string& filename, const std::string& dataset, int num_points, int dim) {
-    std::vector<double> points(num_points * dim);
-    hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    hid_t dset = H5Dopen(file, dataset.c_str(), H5P_DEFAULT);
-    H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, points.data());
-    H5Dclose(dset);
-    H5Fclose(file);
-    return points;
-}
+bool XdmfMeshLoader::ReadDataset(const std::string& full_path, hid_t mem_type, void* dest) {
+    std::string filename, dataset;
+    if (!ParseHDF5Path(full_path, filename, dataset)) return false;
 
-std::vector<uint64_t> XdmfMeshLoader::ReadIndices(const std::string& filename, const std::string& dataset, int num_elements, int nodes_per_element) {
-    std::vector<uint64_t> indices(num_elements * nodes_per_element);
-    hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t file = h5_pool.OpenFile(filename);
+    if (file < 0) {
+        std::cerr << "Failed to open HDF5 file: " << filename << "\n";
+        return false;
+    }
     hid_t dset = H5Dopen(file, dataset.c_str(), H5P_DEFAULT);
-    H5Dread(dset, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, indices.data());
+    if (dset < 0) {
+        std::cerr << "Failed to open dataset: " << full_path << "\n";
+        return false;
+    }
+    herr_t status = H5Dread(dset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, dest);
     H5Dclose(dset);
-    H5Fclose(file);
-    return indices;
+    if (status < 0) {
+        std::cerr << "Failed to read dataset: " << full_path << "\n";
+        return false;
+    }
+    return true;
 }
 
-std::vector<double> XdmfMeshLoader::ReadGeometryData() const {
-    auto [filename, dataset] = ParseHDF5Path(mesh.geometry.hdf5_path);
-    return ReadPoints(filename, dataset, mesh.geometry.num_points, mesh.geometry.dim);
+bool XdmfMeshLoader::ReadPoints(const std::string& full_path, int num_points, int dim) {
+    points.assign(static_cast<size_t>(num_points) * dim, 0.0);
+    return ReadDataset(full_path, H5T_NATIVE_DOUBLE, points.data());
 }
 
-std::vector<uint64_t> XdmfMeshLoader::ReadTopologyData() const {
-    auto [filename, dataset] = ParseHDF5Path(mesh.topology.hdf5_path);
-    return ReadIndices(filename, dataset, mesh.topology.num_elements, mesh.topology.nodes_per_element);
+bool XdmfMeshLoader::ReadIndices(const std::string& full_path, int num_elements, int nodes_per_element) {
+    indices.assign(static_cast<size_t>(num_elements) * nodes_per_element, 0);
+    return ReadDataset(full_path, H5T_NATIVE_UINT64, indices.data());
 }
 
 // 示例主函数
@@ -13,11 +13,41 @@
 #include <array>
 #include <cassert>
 #include <set>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <memory>
+#include <variant>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <functional>
+
+// 内存映射文件
+#ifdef _WIN32
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 // 加载数据使用
 #include "tinyxml2.h"
 #include "H5public.h"
 #include "hdf5.h"
+#include <zlib.h>
 
 
 // ============ openGL 和 窗口库 ================
@@ -36,245 +66,2726 @@
 
 
 
-class XdmfMeshLoader {
+// ============ 并行工具 ================
+
+// 把 [0, count) 切成连续的若干段，每段交给一个线程执行 fn(begin, end)。
+// 数据量太小时直接在当前线程执行，省掉起线程的开销。
+template <typename Fn>
+void ParallelFor(size_t count, Fn&& fn, size_t minPerThread = 16384) {
+    size_t numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, std::max<size_t>(1, count / minPerThread));
+    if (numThreads <= 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    const size_t step = (count + numThreads - 1) / numThreads;
+    for (size_t t = 1; t < numThreads; ++t) {
+        size_t begin = std::min(count, t * step);
+        size_t end = std::min(count, begin + step);
+        workers.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+    fn(size_t(0), std::min(count, step));
+    for (auto& w : workers) w.join();
+}
+
+
+// ============ 加载进度 ================
+
+// 加载的各个阶段，顺序即执行顺序（命中缓存时只有 ReadCache）
+enum class LoadStage {
+    Idle,
+    ParseXml,
+    ReadGeometry,
+    DecodeTopology,
+    MatchFaces,
+    ExtractEdges,
+    ExtractFaces,
+    Simplify,
+    ReadCache,
+    WriteCache,
+    Done,
+    Failed,
+    Cancelled
+};
+
+// 用户取消加载时从当前阶段抛出，一路退回到后台线程的入口
+struct LoadCancelled : std::runtime_error {
+    LoadCancelled() : std::runtime_error("Load cancelled.") {}
+};
+
+// 后台线程写、渲染线程读的加载进度。所有字段都是原子量，不需要加锁。
+// 取消是协作式的：加载代码在阶段切换和长循环里调用 Begin / Update，发现取消标志就抛 LoadCancelled。
+class LoadProgress {
+public:
+    void Begin(LoadStage s) {
+        ThrowIfCancelled();
+        fraction = 0.0f;
+        stage = s;
+    }
+
+    void Update(float f) {
+        ThrowIfCancelled();
+        fraction = f;
+    }
+
+    void Finish(LoadStage s) {
+        fraction = 1.0f;
+        stage = s;
+    }
+
+    void Cancel() { cancelRequested = true; }
+    bool CancelRequested() const { return cancelRequested; }
+
+    LoadStage Stage() const { return stage; }
+    float Fraction() const { return fraction; }
+
+    void ThrowIfCancelled() const {
+        if (cancelRequested) throw LoadCancelled();
+    }
+
+    static const char* StageName(LoadStage s) {
+        switch (s) {
+            case LoadStage::Idle:           return "Idle";
+            case LoadStage::ParseXml:       return "Parsing XDMF";
+            case LoadStage::ReadGeometry:   return "Reading geometry";
+            case LoadStage::DecodeTopology: return "Decoding topology";
+            case LoadStage::MatchFaces:     return "Matching faces";
+            case LoadStage::ExtractEdges:   return "Extracting edges";
+            case LoadStage::ExtractFaces:   return "Extracting faces";
+            case LoadStage::Simplify:       return "Simplifying surface";
+            case LoadStage::ReadCache:      return "Reading mesh cache";
+            case LoadStage::WriteCache:     return "Writing mesh cache";
+            case LoadStage::Done:           return "Done";
+            case LoadStage::Failed:         return "Failed";
+            case LoadStage::Cancelled:      return "Cancelled";
+        }
+        return "";
+    }
+
+private:
+    std::atomic<LoadStage> stage{ LoadStage::Idle };
+    std::atomic<float> fraction{ 0.0f };
+    std::atomic<bool> cancelRequested{ false };
+};
+
+
+// ============ 内存映射文件 ================
+
+// 只读映射整个文件。多个进程映射同一个文件时共享同一份页缓存。
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open file for mapping: " + path);
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) base = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open file for mapping: " + path);
+        struct stat st;
+        fstat(fd, &st);
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) base = static_cast<const uint8_t*>(p);
+        }
+#endif
+        if (!base) {
+            Close();
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        Close();
+    }
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    void Close() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(const_cast<uint8_t*>(base), length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+    }
+};
+
+
+// ============ HDF5 句柄池 ================
+
+// 一次加载会话内共享的 HDF5 句柄：每个 .h5 文件只 H5Fopen 一次，
+// 数据集句柄和它的 dataspace / 数据类型 / 维度也只查询一次。
+// 几何、拓扑和各个 Attribute 往往在同一个文件里，不必每读一个数据集就重新打开文件、重新读 superblock。
+class Hdf5HandlePool {
 public:
-    struct MixedElement {
-        uint8_t type;
-        std::vector<uint64_t> conn;
+    struct DatasetInfo {
+        std::string fileName;
+        hid_t dataset = -1;
+        hid_t space = -1;            // 文件中的 dataspace
+        hid_t type = -1;             // 文件中的数据类型
+        std::vector<hsize_t> dims;
+        hsize_t elementCount = 0;
     };
 
-    std::vector<std::array<double, 3>> geometry;
-    std::vector<MixedElement> mixedTopology;
+    Hdf5HandlePool() = default;
+    Hdf5HandlePool(const Hdf5HandlePool&) = delete;
+    Hdf5HandlePool& operator=(const Hdf5HandlePool&) = delete;
+
+    ~Hdf5HandlePool() {
+        Close();
+    }
 
-    std::unordered_map<std::string, std::vector<int>> nodeAttributes;
-    std::unordered_map<std::string, std::vector<int>> cellAttributes;
+    hid_t OpenFile(const std::string& fileName) {
+        auto it = files.find(fileName);
+        if (it != files.end()) return it->second;
 
-    void Load(const std::string& xdmfFilePath);
+        hid_t file_id = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file_id < 0) throw std::runtime_error("Failed to open HDF5 file: " + fileName);
+        files.emplace(fileName, file_id);
+        return file_id;
+    }
+
+    // hdf5Path 格式: "../data/model_3d.h5:/data0"
+    const DatasetInfo& OpenDataset(const std::string& hdf5Path) {
+        auto it = datasets.find(hdf5Path);
+        if (it != datasets.end()) return it->second;
+
+        size_t pos = hdf5Path.find(':');
+        if (pos == std::string::npos) throw std::runtime_error("Invalid hdf5Path: " + hdf5Path);
+        std::string fileName = hdf5Path.substr(0, pos);
+        std::string datasetName = hdf5Path.substr(pos + 1);
+
+        hid_t file_id = OpenFile(fileName);
+
+        DatasetInfo info;
+        info.fileName = fileName;
+        info.dataset = H5Dopen(file_id, datasetName.c_str(), H5P_DEFAULT);
+        if (info.dataset < 0) throw std::runtime_error("Failed to open dataset: " + hdf5Path);
+
+        info.space = H5Dget_space(info.dataset);
+        info.type = H5Dget_type(info.dataset);
+        int ndims = H5Sget_simple_extent_ndims(info.space);
+        info.dims.resize(ndims > 0 ? ndims : 0);
+        if (ndims > 0) H5Sget_simple_extent_dims(info.space, info.dims.data(), NULL);
+        info.elementCount = 1;
+        for (hsize_t d : info.dims) info.elementCount *= d;
+
+        return datasets.emplace(hdf5Path, std::move(info)).first->second;
+    }
+
+    std::shared_ptr<MappedFile> MapFile(const std::string& fileName) {
+        auto it = mappings.find(fileName);
+        if (it != mappings.end()) return it->second;
+        auto mapped = std::make_shared<MappedFile>(fileName);
+        mappings.emplace(fileName, mapped);
+        return mapped;
+    }
+
+    // 零拷贝快速路径：连续存储、没有过滤器、文件里的类型和 memType 逐字节一致时，
+    // 直接返回数据在映射内存中的地址，keepAlive 持有映射。条件不满足时返回 nullptr，调用方退回 H5Dread。
+    const void* MapDataset(const DatasetInfo& info, hid_t memType, std::shared_ptr<MappedFile>& keepAlive) {
+        if (info.elementCount == 0 || H5Tequal(info.type, memType) <= 0) return nullptr;
+
+        hid_t dcpl = H5Dget_create_plist(info.dataset);
+        bool contiguous = H5Pget_layout(dcpl) == H5D_CONTIGUOUS &&
+                          H5Pget_nfilters(dcpl) == 0 &&
+                          H5Pget_external_count(dcpl) == 0;
+        H5Pclose(dcpl);
+        if (!contiguous) return nullptr;
+
+        // H5Dget_offset 已经是从文件开头算的绝对偏移（含 userblock），不用再加
+        haddr_t address = H5Dget_offset(info.dataset);
+        if (address == HADDR_UNDEF) return nullptr;   // 还没分配存储空间
+
+        const size_t typeSize = H5Tget_size(memType);
+        const uint64_t offset = static_cast<uint64_t>(address);
+        const uint64_t bytes = static_cast<uint64_t>(info.elementCount) * typeSize;
+        if (offset % typeSize != 0) return nullptr;   // 未对齐，不能直接当数组用
+
+        std::shared_ptr<MappedFile> mapped;
+        try {
+            mapped = MapFile(info.fileName);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return nullptr;
+        }
+        if (offset + bytes > mapped->size()) return nullptr;
+
+        keepAlive = mapped;
+        return mapped->data() + offset;
+    }
+
+    // 把整个数据集按 memType 读进 dest。压缩的分块数据集优先走多线程解压，不支持的情况退回 H5Dread。
+    void ReadDataset(const DatasetInfo& info, hid_t memType, void* dest) {
+        if (info.elementCount == 0) return;
+        if (ReadChunkedParallel(info, memType, dest)) return;
+
+        if (H5Dread(info.dataset, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, dest) < 0) {
+            throw std::runtime_error("Failed to read dataset from " + info.fileName);
+        }
+    }
+
+    // 先关数据集再关文件，否则 H5Fclose 会因为还有打开的对象而推迟真正的关闭
+    void Close() {
+        for (auto& [path, info] : datasets) {
+            H5Tclose(info.type);
+            H5Sclose(info.space);
+            H5Dclose(info.dataset);
+        }
+        datasets.clear();
+
+        for (auto& [name, file_id] : files) {
+            H5Fclose(file_id);
+        }
+        files.clear();
+
+        // 已经交出去的视图通过 shared_ptr 持有映射，这里只放掉池子自己的引用
+        mappings.clear();
+    }
 
 private:
-    void ParseDataItem(tinyxml2::XMLElement* dataItem, std::string& hdf5Path, std::vector<hsize_t>& dims);
-    void LoadGeometry(const std::string& hdf5Path, hsize_t numPoints);
-    void LoadMixedTopology(const std::string& hdf5Path);
-    int GetNodeCountForXdmfType(uint8_t type);
+    std::unordered_map<std::string, hid_t> files;
+    std::unordered_map<std::string, DatasetInfo> datasets;
+    std::unordered_map<std::string, std::shared_ptr<MappedFile>> mappings;
+
+    struct RawChunk {
+        std::vector<hsize_t> offset;    // 分块第一个元素在数据集中的坐标
+        uint64_t address = 0;           // 压缩数据在文件中的位置
+        uint64_t size = 0;              // 压缩后的字节数
+        unsigned filterMask = 0;        // 第 k 位为 1 表示写入时跳过了第 k 个过滤器
+    };
+
+    // 分块 + deflate/shuffle 数据集的并行读取：
+    // 先单线程向 HDF5 查询每个分块在文件里的位置（HDF5 本身不是线程安全的），
+    // 然后多线程直接从映射内存取压缩数据，用 zlib 解压、反 shuffle，再拷进目标数组中对应的位置。
+    bool ReadChunkedParallel(const DatasetInfo& info, hid_t memType, void* dest) {
+        if (H5Tequal(info.type, memType) <= 0) return false;  // 需要类型转换的交给 H5Dread
+
+        const int rank = static_cast<int>(info.dims.size());
+        if (rank < 1) return false;
+
+        hid_t dcpl = H5Dget_create_plist(info.dataset);
+        bool supported = H5Pget_layout(dcpl) == H5D_CHUNKED;
+
+        std::vector<hsize_t> chunkDims(rank);
+        if (supported) supported = H5Pget_chunk(dcpl, rank, chunkDims.data()) == rank;
+
+        // 过滤器按写入顺序排列，解码时倒序执行
+        std::vector<H5Z_filter_t> filters;
+        const int nfilters = supported ? H5Pget_nfilters(dcpl) : 0;
+        for (int k = 0; k < nfilters && supported; ++k) {
+            unsigned flags = 0;
+            size_t ncd = 0;
+            H5Z_filter_t id = H5Pget_filter2(dcpl, k, &flags, &ncd, NULL, 0, NULL, NULL);
+            supported = (id == H5Z_FILTER_DEFLATE || id == H5Z_FILTER_SHUFFLE);
+            filters.push_back(id);
+        }
+        H5Pclose(dcpl);
+        if (!supported || filters.empty()) return false;
+
+        // 按分块网格逐个查询位置，有没分配的分块（需要填充值）就交给 H5Dread
+        std::vector<RawChunk> chunks;
+        std::vector<hsize_t> gridCount(rank);
+        hsize_t totalChunks = 1;
+        for (int d = 0; d < rank; ++d) {
+            gridCount[d] = (info.dims[d] + chunkDims[d] - 1) / chunkDims[d];
+            totalChunks *= gridCount[d];
+        }
+        chunks.reserve(totalChunks);
+
+        std::vector<hsize_t> gridPos(rank, 0);
+        for (hsize_t c = 0; c < totalChunks; ++c) {
+            RawChunk chunk;
+            chunk.offset.resize(rank);
+            for (int d = 0; d < rank; ++d) chunk.offset[d] = gridPos[d] * chunkDims[d];
+
+            haddr_t address = HADDR_UNDEF;
+            hsize_t size = 0;
+            if (H5Dget_chunk_info_by_coord(info.dataset, chunk.offset.data(), &chunk.filterMask, &address, &size) < 0 ||
+                address == HADDR_UNDEF) {
+                return false;
+            }
+            chunk.address = address;
+            chunk.size = size;
+            chunks.push_back(std::move(chunk));
+
+            for (int d = rank - 1; d >= 0; --d) {
+                if (++gridPos[d] < gridCount[d]) break;
+                gridPos[d] = 0;
+            }
+        }
+
+        // 分块地址是相对 HDF5 基地址的，文件前面有 userblock 时要加上（和 H5Dget_offset 不同）
+        hsize_t userblock = 0;
+        hid_t fcpl = H5Fget_create_plist(OpenFile(info.fileName));
+        H5Pget_userblock(fcpl, &userblock);
+        H5Pclose(fcpl);
+
+        std::shared_ptr<MappedFile> mapped;
+        try {
+            mapped = MapFile(info.fileName);
+        } catch (const std::exception&) {
+            return false;
+        }
+        for (const auto& chunk : chunks) {
+            if (chunk.address + userblock + chunk.size > mapped->size()) return false;
+        }
+
+        const size_t typeSize = H5Tget_size(memType);
+        size_t chunkElements = 1;
+        for (int d = 0; d < rank; ++d) chunkElements *= static_cast<size_t>(chunkDims[d]);
+        const size_t chunkBytes = chunkElements * typeSize;
+
+        std::atomic<bool> failed{ false };
+        ParallelFor(chunks.size(), [&](size_t begin, size_t end) {
+            std::vector<uint8_t> decoded(chunkBytes);
+            std::vector<uint8_t> scratch(chunkBytes);
+            std::vector<hsize_t> pos(rank);
+
+            for (size_t c = begin; c < end && !failed; ++c) {
+                const RawChunk& chunk = chunks[c];
+                const uint8_t* src = mapped->data() + userblock + chunk.address;
+                size_t srcSize = static_cast<size_t>(chunk.size);
+
+                // 倒序执行过滤器，结果在 decoded 里
+                bool inDecoded = false;
+                for (int k = static_cast<int>(filters.size()) - 1; k >= 0; --k) {
+                    if (chunk.filterMask & (1u << k)) continue;
+                    uint8_t* out = inDecoded ? scratch.data() : decoded.data();
+                    if (filters[k] == H5Z_FILTER_DEFLATE) {
+                        uLongf outSize = static_cast<uLongf>(chunkBytes);
+                        if (uncompress(out, &outSize, src, static_cast<uLong>(srcSize)) != Z_OK || outSize != chunkBytes) {
+                            failed = true;
+                            return;
+                        }
+                    } else {  // H5Z_FILTER_SHUFFLE：第 b 个字节平面连续存放，还原成逐元素排列
+                        if (srcSize != chunkBytes) {
+                            failed = true;
+                            return;
+                        }
+                        for (size_t b = 0; b < typeSize; ++b) {
+                            const uint8_t* plane = src + b * chunkElements;
+                            for (size_t e = 0; e < chunkElements; ++e) out[e * typeSize + b] = plane[e];
+                        }
+                    }
+                    if (inDecoded) std::swap(decoded, scratch);
+                    src = decoded.data();
+                    srcSize = chunkBytes;
+                    inDecoded = true;
+                }
+                if (!inDecoded) {  // 所有过滤器都被跳过，原样拷贝
+                    if (srcSize != chunkBytes) {
+                        failed = true;
+                        return;
+                    }
+                    std::memcpy(decoded.data(), src, chunkBytes);
+                }
+
+                // 边界上的分块在文件里也按完整分块存放，拷贝时裁掉超出数据集的部分。
+                // 最后一维是连续的，按行拷贝，前面各维用计数器遍历。
+                const size_t rowElements = static_cast<size_t>(std::min(chunkDims[rank - 1], info.dims[rank - 1] - chunk.offset[rank - 1]));
+                std::fill(pos.begin(), pos.end(), 0);
+                for (;;) {
+                    size_t srcIndex = 0, dstIndex = 0;
+                    for (int d = 0; d < rank; ++d) {
+                        srcIndex = srcIndex * chunkDims[d] + pos[d];
+                        dstIndex = dstIndex * info.dims[d] + chunk.offset[d] + pos[d];
+                    }
+                    std::memcpy(static_cast<uint8_t*>(dest) + dstIndex * typeSize, decoded.data() + srcIndex * typeSize, rowElements * typeSize);
+
+                    int d = rank - 2;
+                    for (; d >= 0; --d) {
+                        if (++pos[d] < chunkDims[d] && chunk.offset[d] + pos[d] < info.dims[d]) break;
+                        pos[d] = 0;
+                    }
+                    if (d < 0) break;
+                }
+            }
+        }, 1);
+
+        return !failed;
+    }
 };
 
 
-void XdmfMeshLoader::Load(const std::string& xdmfFilePath) {
-    tinyxml2::XMLDocument doc;
-    auto ret = doc.LoadFile(xdmfFilePath.c_str());
-    if (ret != tinyxml2::XML_SUCCESS) {
-        throw std::runtime_error("Failed to load XDMF file.");
+// 节点坐标数组。数据要么是自己分配的，要么是直接指向内存映射文件的只读视图；
+// 两种情况都通过 shared_ptr 持有底层内存，拷贝时只增加引用计数。
+// Scalar 为 double 时是文件里的原始坐标，为 float 时是减去 origin 后的单精度坐标。
+template <typename Scalar>
+class BasicPointArray {
+public:
+    using Point = std::array<Scalar, 3>;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Point& operator[](size_t i) const { return points[i]; }
+    const Point* data() const { return points; }
+    const Point* begin() const { return points; }
+    const Point* end() const { return points + count; }
+    bool IsMapped() const { return mapped; }
+
+    // 分配 n 个点的可写空间，用于 H5Dread 读入
+    Point* Allocate(size_t n) {
+        auto storage = std::make_shared<std::vector<Point>>(n);
+        Point* p = storage->data();
+        points = p;
+        count = n;
+        mapped = false;
+        owner = std::move(storage);
+        return p;
     }
 
-    tinyxml2::XMLElement* root = doc.RootElement(); // Xdmf
-    if (!root) throw std::runtime_error("XDMF root element not found");
+    void SetView(const Point* p, size_t n, std::shared_ptr<const void> keepAlive) {
+        points = p;
+        count = n;
+        mapped = true;
+        owner = std::move(keepAlive);
+    }
+
+    void Clear() {
+        points = nullptr;
+        count = 0;
+        mapped = false;
+        owner.reset();
+    }
+
+private:
+    const Point* points = nullptr;
+    size_t count = 0;
+    bool mapped = false;
+    std::shared_ptr<const void> owner;
+};
+
+using PointArray = BasicPointArray<double>;
+using PointArrayF = BasicPointArray<float>;
+
+
+// 单个单元的只读视图，指向扁平连接数组中的一段，不拥有内存
+template <typename Index>
+struct ElementView {
+    uint8_t type;
+    const Index* nodes;
+    uint32_t count;
+
+    size_t size() const { return count; }
+    Index operator[](size_t i) const { return nodes[i]; }
+    const Index* begin() const { return nodes; }
+    const Index* end() const { return nodes + count; }
+};
+
+// ============ 单元类型表 ================
+
+// XDMF 单元类型编号（Mixed 拓扑里的类型标识）
+enum XdmfCellType : uint8_t {
+    XDMF_POLYVERTEX    = 1,
+    XDMF_POLYLINE      = 2,
+    XDMF_TRIANGLE      = 4,
+    XDMF_QUADRILATERAL = 5,
+    XDMF_TETRAHEDRON   = 6,
+    XDMF_PYRAMID       = 7,
+    XDMF_WEDGE         = 8,
+    XDMF_HEXAHEDRON    = 9,
+    XDMF_TRIANGLE_6    = 36
+};
+
+// 单元的面表。体单元的面从单元外面看是逆时针（右手法向朝外，见下面的 static_assert），三角形面第 4 个位置为 -1。
+// 楔形的三个侧面和金字塔的底面是四边形，作为整个四边形参与配对；二维单元只有一个面，就是它自己。
+struct CellFaceTable {
+    int faceCount;
+    int8_t faces[6][4];
+};
+
+// 单元的棱边表（二维单元就是它的边界）
+struct CellEdgeTable {
+    int edgeCount;
+    int8_t edges[12][2];
+};
+
+// 一种单元类型的全部知识。新增类型只需要在 kElementTraits 里加一行：
+// 解码、按类型分派、面配对、面 / 边提取都从这里读取。
+struct ElementTraits {
+    uint8_t type;
+    const char* name;      // XDMF TopologyType 名称
+    int nodeCount;         // Mixed 数据中类型标识后面的项数
+    int dimension;         // 2 = 面单元，3 = 体单元，0 = 不参与面 / 边提取
+    CellFaceTable faces;
+    CellEdgeTable edges;
+};
+
+constexpr ElementTraits kElementTraits[] = {
+    { XDMF_POLYVERTEX,    "Polyvertex",    2, 0, {}, {} },  // (线)
+    { XDMF_POLYLINE,      "Polyline",      3, 0, {}, {} },  // 2(type), 2, xxx, xxx
+    { XDMF_TRIANGLE,      "Triangle",      3, 2,
+      { 1, { {0, 1, 2, -1} } },
+      { 3, { {0, 1}, {1, 2}, {2, 0} } } },
+    { XDMF_QUADRILATERAL, "Quadrilateral", 4, 2,
+      { 1, { {0, 1, 2, 3} } },
+      { 4, { {0, 1}, {1, 2}, {2, 3}, {3, 0} } } },
+    { XDMF_TETRAHEDRON,   "Tetrahedron",   4, 3,
+      { 4, { {0, 2, 1, -1}, {0, 1, 3, -1}, {1, 2, 3, -1}, {0, 3, 2, -1} } },
+      { 6, { {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3} } } },
+    { XDMF_PYRAMID,       "Pyramid",       5, 3,
+      { 5, { {0, 3, 2, 1}, {0, 1, 4, -1}, {1, 2, 4, -1}, {2, 3, 4, -1}, {3, 0, 4, -1} } },
+      { 8, { {0, 1}, {1, 2}, {2, 3}, {3, 0}, {0, 4}, {1, 4}, {2, 4}, {3, 4} } } },
+    { XDMF_WEDGE,         "Wedge",         6, 3,
+      { 5, { {0, 2, 1, -1}, {3, 4, 5, -1}, {0, 1, 4, 3}, {1, 2, 5, 4}, {2, 0, 3, 5} } },
+      { 9, { {0, 1}, {1, 2}, {2, 0}, {3, 4}, {4, 5}, {5, 3}, {0, 3}, {1, 4}, {2, 5} } } },
+    { XDMF_HEXAHEDRON,    "Hexahedron",    8, 3,
+      { 6, { {0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4}, {3, 7, 6, 2}, {0, 4, 7, 3}, {1, 2, 6, 5} } },
+      { 12, { {0, 1}, {1, 2}, {2, 3}, {3, 0},      // bottom
+              {4, 5}, {5, 6}, {6, 7}, {7, 4},      // top
+              {0, 4}, {1, 5}, {2, 6}, {3, 7} } } },  // sides
+    { XDMF_TRIANGLE_6,    "Triangle_6",    6, 0, {}, {} },  // 带有中点的三角形 2d
+};
+
+constexpr size_t kElementTraitsCount = sizeof(kElementTraits) / sizeof(kElementTraits[0]);
+
+// 类型编号 -> kElementTraits 下标，编译期生成，查表 O(1)
+constexpr std::array<int8_t, 256> MakeElementTraitsIndex() {
+    std::array<int8_t, 256> index{};
+    for (auto& i : index) i = -1;
+    for (size_t i = 0; i < kElementTraitsCount; ++i) index[kElementTraits[i].type] = static_cast<int8_t>(i);
+    return index;
+}
+
+constexpr std::array<int8_t, 256> kElementTraitsIndex = MakeElementTraitsIndex();
+
+// 未知类型返回 nullptr
+constexpr const ElementTraits* ElementTraitsFor(uint8_t type) {
+    return kElementTraitsIndex[type] < 0 ? nullptr : &kElementTraits[kElementTraitsIndex[type]];
+}
+
+// 体单元的参考形状（XDMF 节点编号），只用来在编译期检查面表的绕向
+struct ReferenceCell {
+    uint8_t type;
+    double nodes[8][3];
+};
+
+constexpr ReferenceCell kReferenceCells[] = {
+    { XDMF_TETRAHEDRON, { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1} } },
+    { XDMF_PYRAMID,     { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 1} } },
+    { XDMF_WEDGE,       { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1} } },
+    { XDMF_HEXAHEDRON,  { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1} } },
+};
+
+// 每个面的 Newell 法向都和 (面中心 - 单元中心) 同向，即面从单元外面看是逆时针
+constexpr bool FacesPointOutward(const ReferenceCell& cell) {
+    const ElementTraits* traits = ElementTraitsFor(cell.type);
+    if (!traits || traits->dimension != 3) return false;
+    double center[3] = { 0, 0, 0 };
+    for (int i = 0; i < traits->nodeCount; ++i) {
+        for (int c = 0; c < 3; ++c) center[c] += cell.nodes[i][c] / traits->nodeCount;
+    }
+    for (int f = 0; f < traits->faces.faceCount; ++f) {
+        const int8_t* face = traits->faces.faces[f];
+        const int count = face[3] < 0 ? 3 : 4;
+        double n[3] = { 0, 0, 0 };
+        double faceCenter[3] = { 0, 0, 0 };
+        for (int k = 0; k < count; ++k) {
+            const double* p = cell.nodes[face[k]];
+            const double* q = cell.nodes[face[(k + 1) % count]];
+            n[0] += (p[1] - q[1]) * (p[2] + q[2]);
+            n[1] += (p[2] - q[2]) * (p[0] + q[0]);
+            n[2] += (p[0] - q[0]) * (p[1] + q[1]);
+            for (int c = 0; c < 3; ++c) faceCenter[c] += p[c] / count;
+        }
+        double dot = 0;
+        for (int c = 0; c < 3; ++c) dot += (faceCenter[c] - center[c]) * n[c];
+        if (dot <= 0) return false;
+    }
+    return true;
+}
+
+// 每种体单元都要有参考形状，新增类型时漏了这里也编译不过
+constexpr bool AllFacesPointOutward() {
+    for (const ElementTraits& traits : kElementTraits) {
+        if (traits.dimension != 3) continue;
+        bool checked = false;
+        for (const ReferenceCell& cell : kReferenceCells) {
+            if (cell.type != traits.type) continue;
+            if (!FacesPointOutward(cell)) return false;
+            checked = true;
+        }
+        if (!checked) return false;
+    }
+    return true;
+}
+
+static_assert(AllFacesPointOutward(), "kElementTraits: every volume cell face must wind counter-clockwise seen from outside");
+
+template <size_t I, typename Fn>
+inline void DispatchElementTraits(Fn& fn) {
+    if constexpr (kElementTraits[I].dimension > 0) fn(std::integral_constant<uint8_t, kElementTraits[I].type>());
+}
+
+template <typename Fn, size_t... Is>
+inline bool DispatchElementType(uint8_t type, Fn& fn, std::index_sequence<Is...>) {
+    return ((type == kElementTraits[Is].type ? (DispatchElementTraits<Is>(fn), true) : false) || ...);
+}
+
+// 把运行时的类型编号变成编译期常量：fn(std::integral_constant<uint8_t, Type>)。
+// 只分派参与面 / 边提取的类型（dimension > 0），其它类型什么也不做。
+template <typename Fn>
+inline void DispatchElementType(uint8_t type, Fn&& fn) {
+    DispatchElementType(type, fn, std::make_index_sequence<kElementTraitsCount>());
+}
+
+// fn(localFace, nodes, 3 或 4)，nodes 是全局节点编号
+template <typename Conn, typename Fn>
+inline void ForEachCellFace(const CellFaceTable& table, const Conn& conn, Fn&& fn) {
+    for (int f = 0; f < table.faceCount; ++f) {
+        const int count = table.faces[f][3] < 0 ? 3 : 4;
+        uint64_t nodes[4] = { 0, 0, 0, 0 };
+        for (int k = 0; k < count; ++k) nodes[k] = conn[table.faces[f][k]];
+        fn(f, nodes, count);
+    }
+}
+
+// 单元拓扑的扁平存储，代替每个单元各自 new 一个 vector。两种形式：
+// Mixed（CSR）：
+//   types[e]                      第 e 个单元的 XDMF 类型
+//   offsets[e] .. offsets[e + 1]  第 e 个单元在连接数组中的范围
+// 单一类型（Hexahedron / Quadrilateral 等）：
+//   uniformType 非 0，types / offsets 为空，第 e 个单元就是 conn[e * nodesPerElement ...]
+// 两种形式下 conn32 / conn64 都是所有单元的节点索引首尾相接，节点数不超过 2^32 时只用 32 位
+class CellTopology {
+public:
+    uint8_t uniformType = 0;
+    uint32_t nodesPerElement = 0;
+    std::vector<uint8_t> types;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> conn32;
+    std::vector<uint64_t> conn64;
+    bool wideIndices = false;
+
+    bool IsUniform() const { return uniformType != 0; }
+    size_t connectivitySize() const { return wideIndices ? conn64.size() : conn32.size(); }
+    size_t size() const { return IsUniform() ? connectivitySize() / nodesPerElement : types.size(); }
+    bool empty() const { return size() == 0; }
+
+    void Clear() {
+        uniformType = 0;
+        nodesPerElement = 0;
+        types.clear();
+        offsets.clear();
+        conn32.clear();
+        conn64.clear();
+        wideIndices = false;
+    }
+
+    // 按单元顺序遍历，回调参数是 ElementView<uint32_t> 或 ElementView<uint64_t>，用泛型 lambda 接收即可
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        if (wideIndices) ForEachImpl(conn64, fn);
+        else             ForEachImpl(conn32, fn);
+    }
+
+    // 按类型分派的遍历：fn(std::integral_constant<uint8_t, Type>, const ElementView<Index>&)。
+    // 回调里用 if constexpr 按 Type 写各自的处理，编译器为每种类型单独实例化。
+    // 单一类型拓扑只在开头分派一次，之后的循环里没有任何按类型的分支。
+    // 只分派 kElementTraits 里 dimension > 0 的类型，其它类型（点、折线、高阶单元）直接跳过。
+    template <typename Fn>
+    void ForEachByType(Fn&& fn) const {
+        ForEachByTypeInRange(0, size(), [&](auto type, const auto& elem, size_t) { fn(type, elem); });
+    }
+
+    // 只遍历 [begin, end) 范围内的单元，回调多一个单元下标 fn(type, elem, e)，用于多线程分段处理
+    template <typename Fn>
+    void ForEachByTypeInRange(size_t begin, size_t end, Fn&& fn) const {
+        if (wideIndices) ForEachByTypeImpl(conn64, begin, end, fn);
+        else             ForEachByTypeImpl(conn32, begin, end, fn);
+    }
+
+    // 随机访问第 e 个单元，fn 收到 ElementView<uint32_t> 或 ElementView<uint64_t>
+    template <typename Fn>
+    void VisitElement(size_t e, Fn&& fn) const {
+        if (wideIndices) fn(Element(conn64, e));
+        else             fn(Element(conn32, e));
+    }
+
+    // 随机访问第 e 个单元，conn 传与 wideIndices 一致的 conn32 / conn64
+    template <typename Index>
+    ElementView<Index> Element(const std::vector<Index>& conn, size_t e) const {
+        if (IsUniform()) return ElementView<Index>{ uniformType, conn.data() + e * nodesPerElement, nodesPerElement };
+        return ElementView<Index>{ types[e], conn.data() + offsets[e], static_cast<uint32_t>(offsets[e + 1] - offsets[e]) };
+    }
+
+private:
+    template <typename Index, typename Fn>
+    void ForEachImpl(const std::vector<Index>& conn, Fn& fn) const {
+        if (IsUniform()) {
+            const size_t n = size();
+            for (size_t e = 0; e < n; ++e) {
+                ElementView<Index> elem{ uniformType, conn.data() + e * nodesPerElement, nodesPerElement };
+                fn(elem);
+            }
+            return;
+        }
+        for (size_t e = 0; e < types.size(); ++e) {
+            ElementView<Index> elem{ types[e], conn.data() + offsets[e], static_cast<uint32_t>(offsets[e + 1] - offsets[e]) };
+            fn(elem);
+        }
+    }
+
+    template <uint8_t Type, typename Index, typename Fn>
+    void ForEachUniform(const std::vector<Index>& conn, size_t begin, size_t end, Fn& fn) const {
+        const Index* nodes = conn.data() + begin * nodesPerElement;
+        for (size_t e = begin; e < end; ++e, nodes += nodesPerElement) {
+            fn(std::integral_constant<uint8_t, Type>(), ElementView<Index>{ Type, nodes, nodesPerElement }, e);
+        }
+    }
+
+    template <typename Index, typename Fn>
+    void ForEachByTypeImpl(const std::vector<Index>& conn, size_t begin, size_t end, Fn& fn) const {
+        if (IsUniform()) {
+            DispatchElementType(uniformType, [&](auto type) {
+                ForEachUniform<decltype(type)::value>(conn, begin, end, fn);
+            });
+            return;
+        }
+
+        for (size_t e = begin; e < end; ++e) {
+            ElementView<Index> elem{ types[e], conn.data() + offsets[e], static_cast<uint32_t>(offsets[e + 1] - offsets[e]) };
+            DispatchElementType(elem.type, [&](auto type) { fn(type, elem, e); });
+        }
+    }
+};
+
+// ============ 面配对 ================
+
+// 体网格的面配对：统计每个面被几个单元共享。出现 1 次的是边界面，2 次的是内部面，
+// 3 次及以上说明网格非流形（重复单元、T 型连接等），同时作为网格检查报告出来。
+//
+// 面用 (单元, 局部面号) 编号，faceId = e * 6 + f。按面的最小节点号做一遍并行计数排序
+// （桶 = 节点，相当于以节点号为一位的基数排序），同一个面的所有出现都落在同一个桶里；
+// 桶一般只有十几个面，各桶独立排序、找相同键的连续段，整个过程没有全局哈希表，
+// 额外内存只有每个面一个 faceId 和每个节点一个计数。
+class FaceMatcher {
+public:
+    static constexpr int kMaxFacesPerCell = 6;
+    static constexpr size_t kMaxReported = 16;
+
+    size_t totalFaces = 0;
+    size_t boundaryFaces = 0;
+    size_t interiorFaces = 0;     // 按配对数计，一对算一个
+    size_t nonManifoldFaces = 0;  // 按不同的面计
+    std::vector<std::pair<size_t, int>> nonManifoldSamples;  // 部分非流形面的 (单元, 局部面号)，最多 kMaxReported 个
+
+    // progress 只在调用线程的阶段之间更新（0 ~ progressScale），工作线程里不会抛 LoadCancelled
+    void Match(const CellTopology& topology, uint64_t numPoints, LoadProgress* progress = nullptr, float progressScale = 1.0f) {
+        *this = FaceMatcher();
+        numElements = topology.size();
+        multiplicity.assign(numElements * kMaxFacesPerCell, 0);
+        if (topology.wideIndices) MatchImpl(topology, topology.conn64, numPoints, progress, progressScale);
+        else                      MatchImpl(topology, topology.conn32, numPoints, progress, progressScale);
+    }
+
+    // 共享该面的单元数（255 封顶），不是体单元的面返回 0
+    uint8_t Multiplicity(size_t element, int localFace) const {
+        return multiplicity[element * kMaxFacesPerCell + localFace];
+    }
+
+    bool IsBoundary(size_t element, int localFace) const { return Multiplicity(element, localFace) == 1; }
+
+private:
+    size_t numElements = 0;
+    std::vector<uint8_t> multiplicity;
+
+    using FaceKey = std::array<uint64_t, 4>;
+
+    // 规范键：节点编号升序，三角形第 4 位填最大值，和任何四边形都不相等
+    static FaceKey MakeKey(const uint64_t* nodes, int count) {
+        FaceKey key = { nodes[0], nodes[1], nodes[2], count == 4 ? nodes[3] : std::numeric_limits<uint64_t>::max() };
+        std::sort(key.begin(), key.begin() + count);
+        return key;
+    }
+
+    template <typename Index>
+    void MatchImpl(const CellTopology& topology, const std::vector<Index>& conn, uint64_t numPoints,
+                   LoadProgress* progress, float progressScale) {
+        // 每个面遍历一次，fn(faceId, 最小节点号)
+        auto forEachFace = [&](size_t begin, size_t end, auto&& fn) {
+            topology.ForEachByTypeInRange(begin, end, [&](auto type, const auto& elem, size_t e) {
+                constexpr const ElementTraits& traits = *ElementTraitsFor(type);
+                if constexpr (traits.dimension == 3) {
+                    ForEachCellFace(traits.faces, elem, [&](int f, const uint64_t* nodes, int count) {
+                        uint64_t minNode = nodes[0];
+                        for (int k = 1; k < count; ++k) minNode = std::min(minNode, nodes[k]);
+                        fn(static_cast<uint64_t>(e) * kMaxFacesPerCell + f, minNode);
+                    });
+                }
+            });
+        };
+
+        // 1. 每个节点作为最小节点出现的面数
+        std::vector<std::atomic<uint32_t>> bucketCount(numPoints);
+        std::atomic<size_t> faceCount{ 0 };
+        ParallelFor(numElements, [&](size_t begin, size_t end) {
+            size_t local = 0;
+            forEachFace(begin, end, [&](uint64_t, uint64_t minNode) {
+                bucketCount[minNode].fetch_add(1, std::memory_order_relaxed);
+                ++local;
+            });
+            faceCount += local;
+        });
+        totalFaces = faceCount;
+        if (progress) progress->Update(0.25f * progressScale);
+
+        // 2. 前缀和得到每个桶的起点，计数清零后当作桶内写入游标
+        std::vector<uint64_t> bucketStart(numPoints + 1);
+        bucketStart[0] = 0;
+        for (uint64_t n = 0; n < numPoints; ++n) {
+            bucketStart[n + 1] = bucketStart[n] + bucketCount[n].load(std::memory_order_relaxed);
+            bucketCount[n].store(0, std::memory_order_relaxed);
+        }
+
+        // 3. 把 faceId 分散到各自的桶里，桶内顺序由下一步排序确定，与线程调度无关
+        std::vector<uint64_t> faceIds(totalFaces);
+        ParallelFor(numElements, [&](size_t begin, size_t end) {
+            forEachFace(begin, end, [&](uint64_t faceId, uint64_t minNode) {
+                faceIds[bucketStart[minNode] + bucketCount[minNode].fetch_add(1, std::memory_order_relaxed)] = faceId;
+            });
+        });
+        bucketCount = std::vector<std::atomic<uint32_t>>();
+        if (progress) progress->Update(0.5f * progressScale);
+
+        // 4. 各桶内按 (键, faceId) 排序，相同键的连续段长度就是共享该面的单元数
+        std::atomic<size_t> boundary{ 0 }, interior{ 0 }, nonManifold{ 0 };
+        std::mutex sampleMutex;
+        ParallelFor(numPoints, [&](size_t begin, size_t end) {
+            std::vector<std::pair<FaceKey, uint64_t>> entries;
+            size_t localBoundary = 0, localInterior = 0, localNonManifold = 0;
+            for (size_t b = begin; b < end; ++b) {
+                const uint64_t first = bucketStart[b], last = bucketStart[b + 1];
+                if (first == last) continue;
+
+                entries.clear();
+                for (uint64_t i = first; i < last; ++i) {
+                    const uint64_t faceId = faceIds[i];
+                    const auto elem = topology.Element(conn, faceId / kMaxFacesPerCell);
+                    const int f = static_cast<int>(faceId % kMaxFacesPerCell);
+                    const CellFaceTable& table = ElementTraitsFor(elem.type)->faces;
+                    const int count = table.faces[f][3] < 0 ? 3 : 4;
+                    uint64_t nodes[4];
+                    for (int k = 0; k < count; ++k) nodes[k] = elem[table.faces[f][k]];
+                    entries.emplace_back(MakeKey(nodes, count), faceId);
+                }
+                std::sort(entries.begin(), entries.end());
+
+                for (size_t i = 0; i < entries.size();) {
+                    size_t j = i + 1;
+                    while (j < entries.size() && entries[j].first == entries[i].first) ++j;
+                    const size_t run = j - i;
+                    for (size_t k = i; k < j; ++k) multiplicity[entries[k].second] = static_cast<uint8_t>(std::min<size_t>(run, 255));
+
+                    if (run == 1) ++localBoundary;
+                    else if (run == 2) ++localInterior;
+                    else {
+                        ++localNonManifold;
+                        std::lock_guard<std::mutex> lock(sampleMutex);
+                        if (nonManifoldSamples.size() < kMaxReported) {
+                            nonManifoldSamples.emplace_back(entries[i].second / kMaxFacesPerCell,
+                                                            static_cast<int>(entries[i].second % kMaxFacesPerCell));
+                        }
+                    }
+                    i = j;
+                }
+            }
+            boundary += localBoundary;
+            interior += localInterior;
+            nonManifold += localNonManifold;
+        }, 4096);
+
+        boundaryFaces = boundary;
+        interiorFaces = interior;
+        nonManifoldFaces = nonManifold;
+        // 多线程收集的样本顺序不固定，排一下让报告稳定
+        std::sort(nonManifoldSamples.begin(), nonManifoldSamples.end());
+        if (progress) progress->Update(progressScale);
+    }
+};
+
+
+// ============ 边去重 ================
+
+// 带来源标记的边（例如所属表面多边形的 faceId），用于按相邻面判断特征边
+struct TaggedEdge {
+    uint64_t other;
+    uint64_t tag;
+
+    bool operator<(const TaggedEdge& rhs) const {
+        return other != rhs.other ? other < rhs.other : tag < rhs.tag;
+    }
+};
+
+// 边去重：和 FaceMatcher 一样按较小的节点号分桶（并行计数排序），桶里只存较大的节点号，
+// 桶内排序后同一条边的所有出现相邻。Entry 为 uint64_t 时不带标记，为 TaggedEdge 时带。
+template <typename Entry>
+class EdgeGrouper {
+public:
+    // produce(begin, end, emit) 遍历第 [begin, end) 个输入项，每条边调用一次 emit(a, b, tag)。
+    // 计数和分桶各调用一遍，两遍产生的边必须一致。
+    template <typename Produce>
+    void Build(size_t numItems, uint64_t numPoints, Produce&& produce) {
+        std::vector<std::atomic<uint32_t>> bucketCount(numPoints);
+        ParallelFor(numItems, [&](size_t begin, size_t end) {
+            produce(begin, end, [&](uint64_t a, uint64_t b, uint64_t) {
+                bucketCount[std::min(a, b)].fetch_add(1, std::memory_order_relaxed);
+            });
+        });
+
+        bucketStart.assign(numPoints + 1, 0);
+        for (uint64_t n = 0; n < numPoints; ++n) {
+            bucketStart[n + 1] = bucketStart[n] + bucketCount[n].load(std::memory_order_relaxed);
+            bucketCount[n].store(0, std::memory_order_relaxed);
+        }
+
+        entries.resize(bucketStart[numPoints]);
+        ParallelFor(numItems, [&](size_t begin, size_t end) {
+            produce(begin, end, [&](uint64_t a, uint64_t b, uint64_t tag) {
+                const uint64_t lo = std::min(a, b);
+                entries[bucketStart[lo] + bucketCount[lo].fetch_add(1, std::memory_order_relaxed)] = MakeEntry(std::max(a, b), tag);
+            });
+        });
+
+        ParallelFor(numPoints, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                std::sort(entries.begin() + bucketStart[b], entries.begin() + bucketStart[b + 1]);
+            }
+        }, 4096);
+    }
+
+    // 按 (a, b) 升序遍历每条不同的边，fn(a, b, first, count)，[first, first + count) 是这条边的所有出现
+    template <typename Fn>
+    void ForEachEdge(Fn&& fn) const {
+        const uint64_t numPoints = bucketStart.empty() ? 0 : bucketStart.size() - 1;
+        for (uint64_t a = 0; a < numPoints; ++a) {
+            const Entry* it = entries.data() + bucketStart[a];
+            const Entry* last = entries.data() + bucketStart[a + 1];
+            while (it != last) {
+                const Entry* run = it + 1;
+                while (run != last && Other(*run) == Other(*it)) ++run;
+                fn(a, Other(*it), it, static_cast<size_t>(run - it));
+                it = run;
+            }
+        }
+    }
+
+    size_t occurrences() const { return entries.size(); }
+
+private:
+    std::vector<uint64_t> bucketStart;
+    std::vector<Entry> entries;
+
+    static Entry MakeEntry(uint64_t other, uint64_t tag) {
+        if constexpr (std::is_same_v<Entry, TaggedEdge>) return TaggedEdge{ other, tag };
+        else return other;
+    }
+
+    static uint64_t Other(uint64_t entry) { return entry; }
+    static uint64_t Other(const TaggedEdge& entry) { return entry.other; }
+};
+
+
+// ============ XDMF Attribute ================
+
+// Attribute 在内存中的存储类型，由 DataItem 的 DataType 和 Precision 决定
+enum class AttributeValueType {
+    Int32,
+    Int64,
+    Float32,
+    Float64
+};
+
+// 一个 XDMF Attribute：解析 XML 时只记下它在 HDF5 里的位置和类型，第一次访问数据时才真正读取。
+// 数据放在共享的 State 里，loader 被拷贝后各份之间也只读一次。
+class XdmfAttribute {
+public:
+    using Storage = std::variant<std::vector<int32_t>, std::vector<int64_t>, std::vector<float>, std::vector<double>>;
+
+    std::string name;
+    std::string attributeType;      // Scalar / Vector / Tensor ...
+    std::string center;             // Node / Cell
+    std::string hdf5Path;           // "../data/model_3d.h5:/data2"
+    std::vector<hsize_t> dims;
+    AttributeValueType valueType = AttributeValueType::Float64;
+
+    XdmfAttribute() : state(std::make_shared<State>()) {}
+
+    static AttributeValueType ValueTypeFor(const char* dataType, int precision) {
+        std::string t = dataType ? dataType : "Float";  // XDMF 默认 Float
+        if (t == "Float") return precision == 8 ? AttributeValueType::Float64 : AttributeValueType::Float32;
+        // 4 字节 UInt 的 2^31 以上放不进 int32，升到 int64
+        if (precision == 8 || (t == "UInt" && precision == 4)) return AttributeValueType::Int64;
+        return AttributeValueType::Int32;  // Int / 较短的 UInt / Char / UChar
+    }
+
+    size_t size() const {
+        size_t n = 1;
+        for (hsize_t d : dims) n *= static_cast<size_t>(d);
+        return n;
+    }
+
+    bool IsLoaded() const { return state->loaded; }
+
+    // 按存储类型取数据，T 必须和 valueType 一致，例如 Precision="4" 的 Int 用 Get<int32_t>()
+    template <typename T>
+    const std::vector<T>& Get() const {
+        Load();
+        const auto* values = std::get_if<std::vector<T>>(&state->data);
+        if (!values) throw std::runtime_error("Attribute '" + name + "' requested with a different value type.");
+        return *values;
+    }
+
+    // 不关心具体类型时用：fn 会收到 const std::vector<int32_t/int64_t/float/double>&
+    template <typename Fn>
+    decltype(auto) Visit(Fn&& fn) const {
+        Load();
+        return std::visit(std::forward<Fn>(fn), state->data);
+    }
+
+    // 释放已读入的数据，下次访问时重新读取
+    void Unload() const {
+        state->data = Storage();
+        state->loaded = false;
+    }
+
+private:
+    friend class XdmfMeshLoader;
+
+    struct State {
+        std::shared_ptr<Hdf5HandlePool> pool;
+        Storage data;
+        bool loaded = false;
+    };
+    std::shared_ptr<State> state;
+
+    template <typename T>
+    void ReadAs(hid_t memType) const {
+        const auto& info = state->pool->OpenDataset(hdf5Path);
+        if (info.elementCount != size()) {
+            throw std::runtime_error("Attribute '" + name + "' dataset size does not match XDMF Dimensions.");
+        }
+        std::vector<T> values(size());
+        try {
+            state->pool->ReadDataset(info, memType, values.data());
+        } catch (const std::exception&) {
+            throw std::runtime_error("Failed to read attribute '" + name + "'.");
+        }
+        state->data = std::move(values);
+    }
+
+    void Load() const {
+        if (state->loaded) return;
+        if (!state->pool) throw std::runtime_error("Attribute '" + name + "' has no open HDF5 session.");
+
+        switch (valueType) {
+            case AttributeValueType::Int32:   ReadAs<int32_t>(H5T_NATIVE_INT32);  break;
+            case AttributeValueType::Int64:   ReadAs<int64_t>(H5T_NATIVE_INT64);  break;
+            case AttributeValueType::Float32: ReadAs<float>(H5T_NATIVE_FLOAT);    break;
+            case AttributeValueType::Float64: ReadAs<double>(H5T_NATIVE_DOUBLE);  break;
+        }
+        state->loaded = true;
+    }
+};
+
+
+class XdmfMeshLoader {
+public:
+    // 连续存储、未压缩的数据集直接映射文件，不再 H5Dread 到新分配的内存
+    bool useMemoryMap = true;
+
+    // 单精度模式：坐标减去包围盒中心后直接存成 float（geometryF），geometry 保持为空。
+    // 远离原点的模型这样也不会丢精度，坐标内存减半，提取网格时也不用再逐点转换。
+    // 还原原始坐标（拾取、导出）：geometryF[i] + origin。
+    bool singlePrecision = false;
+
+    // 非空时在各阶段开始前更新进度并检查取消
+    LoadProgress* progress = nullptr;
+
+    PointArray geometry;
+    PointArrayF geometryF;
+    std::array<double, 3> origin = { 0.0, 0.0, 0.0 };
+    CellTopology topology;
+
+    size_t PointCount() const { return singlePrecision ? geometryF.size() : geometry.size(); }
+
+    // 用泛型 lambda 访问当前精度的坐标数组：fn(const PointArray&) 或 fn(const PointArrayF&)
+    template <typename Fn>
+    void VisitGeometry(Fn&& fn) const {
+        if (singlePrecision) fn(geometryF);
+        else                 fn(geometry);
+    }
+
+    // 解析时只建立索引，数据在第一次 Get / Visit 时读取
+    std::unordered_map<std::string, XdmfAttribute> nodeAttributes;
+    std::unordered_map<std::string, XdmfAttribute> cellAttributes;
+
+    void Load(const std::string& xdmfFilePath);
+
+    // 只解析 XML，列出 XDMF 引用到的所有 HDF5 文件（去重，按出现顺序）
+    static std::vector<std::string> ReferencedFiles(const std::string& xdmfFilePath);
+
+private:
+    // 本次加载会话打开的 HDF5 文件和数据集，Load 开始时新建
+    std::shared_ptr<Hdf5HandlePool> h5Pool;
+
+    void ParseDataItem(tinyxml2::XMLElement* dataItem, std::string& hdf5Path, std::vector<hsize_t>& dims);
+    void LoadGeometry(const std::string& hdf5Path, hsize_t numPoints, hsize_t dim);
+    void RecenterGeometry(const double* coords, size_t numPoints, size_t dim);
+    void LoadMixedTopology(const std::string& hdf5Path, size_t expectedElements);
+    void DecodeMixedTopology(const int64_t* rawData, size_t rawSize, size_t expectedElements);
+    void LoadUniformTopology(const std::string& hdf5Path, uint8_t type, uint32_t nodesPerElement, size_t numElements);
+    void DecodeUniformTopology(const int64_t* rawData, size_t numElements, uint8_t type, uint32_t nodesPerElement);
+    static bool ConvertConnectivity(const int64_t* src, size_t count, uint64_t numPoints, uint32_t* dst);
+    static bool ConvertConnectivity(const int64_t* src, size_t count, uint64_t numPoints, uint64_t* dst);
+    static uint8_t GetXdmfTypeForTopologyName(const std::string& topologyType);
+    void IndexAttributes(tinyxml2::XMLElement* grid);
+    int GetNodeCountForXdmfType(uint8_t type);
+};
+
+
+void XdmfMeshLoader::Load(const std::string& xdmfFilePath) {
+    if (progress) progress->Begin(LoadStage::ParseXml);
+    h5Pool = std::make_shared<Hdf5HandlePool>();
+
+    tinyxml2::XMLDocument doc;
+    auto ret = doc.LoadFile(xdmfFilePath.c_str());
+    if (ret != tinyxml2::XML_SUCCESS) {
+        throw std::runtime_error("Failed to load XDMF file.");
+    }
+
+    tinyxml2::XMLElement* root = doc.RootElement(); // Xdmf
+    if (!root) throw std::runtime_error("XDMF root element not found");
+
+    tinyxml2::XMLElement* domain = root->FirstChildElement("Domain");
+    if (!domain) throw std::runtime_error("Domain element not found");
+
+    tinyxml2::XMLElement* grid = domain->FirstChildElement("Grid");
+    if (!grid) throw std::runtime_error("Grid element not found");
+
+    // 解析 Geometry 节点
+    tinyxml2::XMLElement* geometry = grid->FirstChildElement("Geometry");
+    if (!geometry) throw std::runtime_error("Geometry element not found");
+
+    std::string geomHdf5Path;
+    std::vector<hsize_t> geomDims;
+    tinyxml2::XMLElement* geomDataItem = geometry->FirstChildElement("DataItem");
+    if (!geomDataItem) throw std::runtime_error("Geometry DataItem not found");
+
+    ParseDataItem(geomDataItem, geomHdf5Path, geomDims);
+
+    // GeometryType="XYZ" 是 Nx3，"XY"（二维模型）是 Nx2，z 补 0
+    const char* geomType = geometry->Attribute("GeometryType");
+    const hsize_t geomDim = (geomType && std::string(geomType) == "XY") ? 2 : 3;
+    if (geomDims.size() != 2 || geomDims[1] != geomDim) {
+        throw std::runtime_error("Geometry dimensions invalid, expected Nx" + std::to_string(geomDim) + ".");
+    }
+    if (progress) progress->Begin(LoadStage::ReadGeometry);
+    LoadGeometry(geomHdf5Path, geomDims[0], geomDim);
+
+    // 解析 Topology 节点
+    if (progress) progress->Begin(LoadStage::DecodeTopology);
+    tinyxml2::XMLElement* topoElem = grid->FirstChildElement("Topology");
+    if (!topoElem) throw std::runtime_error("Topology element not found");
+
+    const char* topoType = topoElem->Attribute("TopologyType");
+    if (!topoType) throw std::runtime_error("Topology TopologyType attribute missing.");
+
+    tinyxml2::XMLElement* topoDataItem = topoElem->FirstChildElement("DataItem");
+    if (!topoDataItem) throw std::runtime_error("Topology DataItem not found");
+
+    std::string topoHdf5Path;
+    std::vector<hsize_t> topoDims;
+    ParseDataItem(topoDataItem, topoHdf5Path, topoDims);
+
+    // NumberOfElements 用来预先分配解码缓冲区，并校验解出来的单元数
+    int64_t numberOfElements = 0;
+    topoElem->QueryInt64Attribute("NumberOfElements", &numberOfElements);
+
+    if (std::string(topoType) == "Mixed") {
+        LoadMixedTopology(topoHdf5Path, static_cast<size_t>(std::max<int64_t>(numberOfElements, 0)));
+    } else {
+        // 单一类型拓扑：DataItem 是 NumberOfElements x NodesPerElement，没有逐单元的类型标识
+        uint8_t type = GetXdmfTypeForTopologyName(topoType);
+        if (type == 0) throw std::runtime_error(std::string("Unsupported topology type: ") + topoType);
+
+        const int nodesPerElement = GetNodeCountForXdmfType(type);
+        const int declaredNodes = topoElem->IntAttribute("NodesPerElement", nodesPerElement);
+        if (declaredNodes != nodesPerElement) {
+            throw std::runtime_error(std::string("NodesPerElement does not match topology type ") + topoType);
+        }
+
+        hsize_t total = 1;
+        for (hsize_t d : topoDims) total *= d;
+        if (topoDims.empty() || total % nodesPerElement != 0) {
+            throw std::runtime_error("Topology dimensions invalid for " + std::string(topoType));
+        }
+        const size_t numElements = static_cast<size_t>(total / nodesPerElement);
+        if (numberOfElements > 0 && static_cast<size_t>(numberOfElements) != numElements) {
+            throw std::runtime_error("Topology NumberOfElements does not match DataItem Dimensions.");
+        }
+
+        LoadUniformTopology(topoHdf5Path, type, static_cast<uint32_t>(nodesPerElement), numElements);
+    }
+
+    // 解析 Attribute 节点（只建索引，不读数据）
+    IndexAttributes(grid);
+}
+
+std::vector<std::string> XdmfMeshLoader::ReferencedFiles(const std::string& xdmfFilePath) {
+    tinyxml2::XMLDocument doc;
+    if (doc.LoadFile(xdmfFilePath.c_str()) != tinyxml2::XML_SUCCESS) {
+        throw std::runtime_error("Failed to load XDMF file.");
+    }
+
+    std::vector<std::string> files;
+    std::vector<tinyxml2::XMLElement*> stack;
+    if (doc.RootElement()) stack.push_back(doc.RootElement());
+    while (!stack.empty()) {
+        tinyxml2::XMLElement* elem = stack.back();
+        stack.pop_back();
+
+        const char* format = elem->Attribute("Format");
+        if (std::string(elem->Name()) == "DataItem" && format && std::string(format) == "HDF" && elem->GetText()) {
+            std::string text = elem->GetText();
+            size_t start = text.find_first_not_of(" \t\r\n");
+            size_t pos = text.find(':', start == std::string::npos ? 0 : start);
+            if (start != std::string::npos && pos != std::string::npos) {
+                std::string fileName = text.substr(start, pos - start);
+                if (std::find(files.begin(), files.end(), fileName) == files.end()) files.push_back(fileName);
+            }
+        }
+
+        // 倒序压栈，保证按文档顺序出栈
+        std::vector<tinyxml2::XMLElement*> children;
+        for (auto* child = elem->FirstChildElement(); child; child = child->NextSiblingElement()) children.push_back(child);
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+    return files;
+}
+
+void XdmfMeshLoader::IndexAttributes(tinyxml2::XMLElement* grid) {
+    nodeAttributes.clear();
+    cellAttributes.clear();
+
+    for (tinyxml2::XMLElement* attribute = grid->FirstChildElement("Attribute"); attribute;
+         attribute = attribute->NextSiblingElement("Attribute")) {
+        const char* name = attribute->Attribute("Name");
+        const char* center = attribute->Attribute("Center");
+        tinyxml2::XMLElement* dataItem = attribute->FirstChildElement("DataItem");
+        if (!name || !dataItem) {
+            std::cerr << "Skipping Attribute without Name or DataItem\n";
+            continue;
+        }
+
+        XdmfAttribute attr;
+        attr.name = name;
+        attr.center = center ? center : "Node";  // XDMF 默认 Node
+        const char* attrType = attribute->Attribute("AttributeType");
+        attr.attributeType = attrType ? attrType : "Scalar";
+        ParseDataItem(dataItem, attr.hdf5Path, attr.dims);
+        attr.valueType = XdmfAttribute::ValueTypeFor(dataItem->Attribute("DataType"), dataItem->IntAttribute("Precision", 4));
+        attr.state->pool = h5Pool;
+
+        std::unordered_map<std::string, XdmfAttribute>* target = nullptr;
+        size_t expected = 0;
+        if (attr.center == "Node") {
+            target = &nodeAttributes;
+            expected = PointCount();
+        } else if (attr.center == "Cell") {
+            target = &cellAttributes;
+            expected = topology.size();
+        } else {
+            std::cerr << "Skipping Attribute '" << attr.name << "' with unsupported Center " << attr.center << "\n";
+            continue;
+        }
+
+        if (attr.dims.empty() || attr.dims[0] != expected) {
+            std::cerr << "Skipping Attribute '" << attr.name << "': " << attr.center << " attribute size does not match mesh\n";
+            continue;
+        }
+
+        (*target)[attr.name] = std::move(attr);
+    }
+}
+
+void XdmfMeshLoader::ParseDataItem(tinyxml2::XMLElement* dataItem, std::string& hdf5Path, std::vector<hsize_t>& dims) {
+    const char* dimsStr = dataItem->Attribute("Dimensions");
+    if (!dimsStr) throw std::runtime_error("DataItem Dimensions attribute missing.");
+
+    // 解析 Dimensions 格式 "30574 3" 为 vector<hsize_t>
+    dims.clear();
+    std::stringstream ss(dimsStr);
+    std::string token;
+    while (ss >> token) {
+        dims.push_back(static_cast<hsize_t>(std::stoull(token)));
+    }
+
+    const char* format = dataItem->Attribute("Format");
+    if (!format || std::string(format) != "HDF") {
+        throw std::runtime_error("Only HDF format supported.");
+    }
+
+    const char* text = dataItem->GetText();
+    if (!text) throw std::runtime_error("DataItem text missing (expected HDF file path and dataset).");
+
+    // text格式一般是 "../data/model_3d.h5:/data0"，前后常带换行和缩进，要去掉
+    std::string fullStr(text);
+    size_t start = fullStr.find_first_not_of(" \t\r\n");
+    size_t end = fullStr.find_last_not_of(" \t\r\n");
+    fullStr = (start == std::string::npos) ? std::string() : fullStr.substr(start, end - start + 1);
+    size_t pos = fullStr.find(':');
+    if (pos == std::string::npos) throw std::runtime_error("HDF5 dataset path invalid.");
+
+    hdf5Path = fullStr.substr(0, pos) + ":" + fullStr.substr(pos + 1);
+}
+
+void XdmfMeshLoader::LoadGeometry(const std::string& hdf5Path, hsize_t numPoints, hsize_t dim) {
+    // hdf5Path 格式: "../data/model_3d.h5:/data0"
+    const auto& info = h5Pool->OpenDataset(hdf5Path);
+    if (info.elementCount != numPoints * dim) {
+        throw std::runtime_error("Geometry dataset size does not match XDMF Dimensions.");
+    }
+
+    geometry.Clear();
+    geometryF.Clear();
+    origin = { 0.0, 0.0, 0.0 };
+
+    if (singlePrecision) {
+        // 映射成功时直接从文件页读 double，否则先读进临时数组；转换完只留下 float 坐标
+        std::shared_ptr<MappedFile> mapping;
+        const void* p = useMemoryMap ? h5Pool->MapDataset(info, H5T_NATIVE_DOUBLE, mapping) : nullptr;
+        if (p) {
+            RecenterGeometry(static_cast<const double*>(p), numPoints, dim);
+            return;
+        }
+
+        std::vector<double> coords(numPoints * dim);
+        try {
+            h5Pool->ReadDataset(info, H5T_NATIVE_DOUBLE, coords.data());
+        } catch (const std::exception&) {
+            throw std::runtime_error("Failed to read geometry data.");
+        }
+        RecenterGeometry(coords.data(), numPoints, dim);
+        return;
+    }
+
+    // 快速路径：直接把文件里的 double[N][3] 当作坐标数组
+    if (useMemoryMap && dim == 3) {
+        std::shared_ptr<MappedFile> mapping;
+        if (const void* p = h5Pool->MapDataset(info, H5T_NATIVE_DOUBLE, mapping)) {
+            geometry.SetView(static_cast<const PointArray::Point*>(p), numPoints, std::move(mapping));
+            return;
+        }
+    }
+
+    // 读取数据（压缩的分块数据集会多线程解压）
+    PointArray::Point* points = geometry.Allocate(numPoints);
+    try {
+        if (dim == 3) {
+            h5Pool->ReadDataset(info, H5T_NATIVE_DOUBLE, points);
+        } else {
+            // XY 坐标先读进临时数组，再展开成 xyz，z = 0
+            std::vector<double> xy(numPoints * dim);
+            h5Pool->ReadDataset(info, H5T_NATIVE_DOUBLE, xy.data());
+            ParallelFor(numPoints, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) points[i] = { xy[i * dim], xy[i * dim + 1], 0.0 };
+            });
+        }
+    } catch (const std::exception&) {
+        geometry.Clear();
+        throw std::runtime_error("Failed to read geometry data.");
+    }
+}
+
+// 求包围盒中心作为 origin，再把 double 坐标减去 origin 存成 float。dim 为 2 时 z 取 0。
+void XdmfMeshLoader::RecenterGeometry(const double* coords, size_t numPoints, size_t dim) {
+    std::array<double, 3> lo = { 0.0, 0.0, 0.0 };
+    std::array<double, 3> hi = { 0.0, 0.0, 0.0 };
+    if (numPoints > 0) {
+        const double inf = std::numeric_limits<double>::infinity();
+        lo = { inf, inf, dim == 3 ? inf : 0.0 };
+        hi = { -inf, -inf, dim == 3 ? -inf : 0.0 };
+
+        std::mutex mergeMutex;
+        ParallelFor(numPoints, [&](size_t begin, size_t end) {
+            std::array<double, 3> l = lo, h = hi;
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t k = 0; k < dim; ++k) {
+                    const double v = coords[i * dim + k];
+                    l[k] = std::min(l[k], v);
+                    h[k] = std::max(h[k], v);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            for (size_t k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], l[k]);
+                hi[k] = std::max(hi[k], h[k]);
+            }
+        });
+    }
+    origin = { (lo[0] + hi[0]) * 0.5, (lo[1] + hi[1]) * 0.5, (lo[2] + hi[2]) * 0.5 };
+
+    PointArrayF::Point* points = geometryF.Allocate(numPoints);
+    ParallelFor(numPoints, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double* c = coords + i * dim;
+            points[i] = {
+                static_cast<float>(c[0] - origin[0]),
+                static_cast<float>(c[1] - origin[1]),
+                dim == 3 ? static_cast<float>(c[2] - origin[2]) : 0.0f
+            };
+        }
+    });
+}
+
+void XdmfMeshLoader::LoadMixedTopology(const std::string& hdf5Path, size_t expectedElements) {
+    // hdf5Path 格式: "../data/model_3d.h5:/data1"
+    const auto& info = h5Pool->OpenDataset(hdf5Path);
+
+    // 获取数据集尺寸，读取一维 int64_t 数组
+    if (info.dims.size() != 1) {
+        throw std::runtime_error("Topology data should be 1D.");
+    }
+
+    // 快速路径：直接从映射内存解码，省掉整块 int64 中间缓冲区
+    if (useMemoryMap) {
+        std::shared_ptr<MappedFile> mapping;
+        if (const void* p = h5Pool->MapDataset(info, H5T_NATIVE_INT64, mapping)) {
+            DecodeMixedTopology(static_cast<const int64_t*>(p), info.dims[0], expectedElements);
+            return;
+        }
+    }
+
+    // 读取全部数据
+    std::vector<int64_t> rawData(info.dims[0]);
+    try {
+        h5Pool->ReadDataset(info, H5T_NATIVE_INT64, rawData.data());
+    } catch (const std::exception&) {
+        throw std::runtime_error("Failed to read topology data.");
+    }
+
+    DecodeMixedTopology(rawData.data(), rawData.size(), expectedElements);
+}
+
+void XdmfMeshLoader::DecodeMixedTopology(const int64_t* rawData, size_t rawSize, size_t expectedElements) {
+    // 清空旧数据
+    topology.Clear();
+
+    // Mixed拓扑格式：
+    // 数据中，前一个元素是类型标识符 type，
+    // 后面紧跟该单元的节点索引，节点个数通过 type 得到
+    //
+    // 单元的起点只能顺序扫出来，所以第一遍单线程只跳着读类型标识，记下 types 和 offsets；
+    // 第 e 个单元的类型标识在 rawData[offsets[e] + e]，因此不需要额外保存原始位置。
+    // 第二遍按单元分段，多线程做类型转换和节点编号的范围检查。
+
+    topology.types.reserve(expectedElements);
+    topology.offsets.reserve(expectedElements + 1);
+
+    size_t numConn = 0;
+    size_t i = 0;
+    while (i < rawSize) {
+        int64_t type = rawData[i];
+        int nodeCount = (type >= 0 && type <= 255) ? GetNodeCountForXdmfType(static_cast<uint8_t>(type)) : -1;
+        if (nodeCount <= 0) {
+            throw std::runtime_error("Unknown XDMF element type: " + std::to_string(type) +
+                                     " at topology entry " + std::to_string(i));
+        }
+
+        if (i + nodeCount >= rawSize) {
+            throw std::runtime_error("Topology data corrupted or incomplete.");
+        }
+
+        topology.types.push_back(static_cast<uint8_t>(type));
+        topology.offsets.push_back(numConn);
+        numConn += nodeCount;
+        i += 1 + nodeCount;
+    }
+    topology.offsets.push_back(numConn);
+
+    const size_t numElements = topology.types.size();
+    if (expectedElements != 0 && numElements != expectedElements) {
+        throw std::runtime_error("Topology NumberOfElements mismatch: expected " + std::to_string(expectedElements) +
+                                 ", decoded " + std::to_string(numElements));
+    }
+
+    // 节点数放得下 32 位时连接数组只用一半内存
+    const uint64_t numPoints = PointCount();
+    topology.wideIndices = numPoints > std::numeric_limits<uint32_t>::max();
+    if (topology.wideIndices) topology.conn64.resize(numConn);
+    else                      topology.conn32.resize(numConn);
+
+    // 记录第一个越界的单元，各线程取最小值，保证报错信息和单线程时一致
+    std::atomic<size_t> firstBadElement{ std::numeric_limits<size_t>::max() };
+
+    auto decodeRange = [&](auto* conn, size_t begin, size_t end) {
+        for (size_t e = begin; e < end; ++e) {
+            const size_t c0 = topology.offsets[e];
+            const size_t c1 = topology.offsets[e + 1];
+            if (!ConvertConnectivity(rawData + c0 + e + 1, c1 - c0, numPoints, conn + c0)) {
+                size_t prev = firstBadElement.load();
+                while (e < prev && !firstBadElement.compare_exchange_weak(prev, e)) {}
+                return;
+            }
+        }
+    };
+
+    ParallelFor(numElements, [&](size_t begin, size_t end) {
+        if (topology.wideIndices) decodeRange(topology.conn64.data(), begin, end);
+        else                      decodeRange(topology.conn32.data(), begin, end);
+    });
+
+    if (firstBadElement.load() != std::numeric_limits<size_t>::max()) {
+        size_t e = firstBadElement.load();
+        topology.Clear();
+        throw std::runtime_error("Topology element " + std::to_string(e) + " references a node outside geometry (" +
+                                 std::to_string(numPoints) + " points).");
+    }
+}
+
+// 转换一段连接数据并检查节点编号范围，返回 false 表示有越界
+bool XdmfMeshLoader::ConvertConnectivity(const int64_t* src, size_t count, uint64_t numPoints, uint32_t* dst) {
+    bool ok = true;
+    for (size_t c = 0; c < count; ++c) {
+        // 负数转成 uint64 后一定大于 numPoints，一次比较就同时查了两头
+        ok &= static_cast<uint64_t>(src[c]) < numPoints;
+        dst[c] = static_cast<uint32_t>(src[c]);
+    }
+    return ok;
+}
+
+bool XdmfMeshLoader::ConvertConnectivity(const int64_t* src, size_t count, uint64_t numPoints, uint64_t* dst) {
+    bool ok = true;
+    for (size_t c = 0; c < count; ++c) {
+        ok &= static_cast<uint64_t>(src[c]) < numPoints;
+        dst[c] = static_cast<uint64_t>(src[c]);
+    }
+    return ok;
+}
+
+void XdmfMeshLoader::LoadUniformTopology(const std::string& hdf5Path, uint8_t type, uint32_t nodesPerElement, size_t numElements) {
+    const auto& info = h5Pool->OpenDataset(hdf5Path);
+    if (info.elementCount != static_cast<hsize_t>(numElements) * nodesPerElement) {
+        throw std::runtime_error("Topology dataset size does not match XDMF Dimensions.");
+    }
+
+    // 快速路径：直接从映射内存解码
+    if (useMemoryMap) {
+        std::shared_ptr<MappedFile> mapping;
+        if (const void* p = h5Pool->MapDataset(info, H5T_NATIVE_INT64, mapping)) {
+            DecodeUniformTopology(static_cast<const int64_t*>(p), numElements, type, nodesPerElement);
+            return;
+        }
+    }
+
+    std::vector<int64_t> rawData(static_cast<size_t>(info.elementCount));
+    try {
+        h5Pool->ReadDataset(info, H5T_NATIVE_INT64, rawData.data());
+    } catch (const std::exception&) {
+        throw std::runtime_error("Failed to read topology data.");
+    }
+
+    DecodeUniformTopology(rawData.data(), numElements, type, nodesPerElement);
+}
+
+void XdmfMeshLoader::DecodeUniformTopology(const int64_t* rawData, size_t numElements, uint8_t type, uint32_t nodesPerElement) {
+    topology.Clear();
+    topology.uniformType = type;
+    topology.nodesPerElement = nodesPerElement;
+
+    // 没有类型标识，单元起点可以直接算出来，整段都能并行转换
+    const uint64_t numPoints = PointCount();
+    const size_t numConn = numElements * nodesPerElement;
+    topology.wideIndices = numPoints > std::numeric_limits<uint32_t>::max();
+    if (topology.wideIndices) topology.conn64.resize(numConn);
+    else                      topology.conn32.resize(numConn);
+
+    std::atomic<size_t> firstBadElement{ std::numeric_limits<size_t>::max() };
+    ParallelFor(numElements, [&](size_t begin, size_t end) {
+        const size_t c0 = begin * nodesPerElement;
+        const size_t count = (end - begin) * nodesPerElement;
+        bool ok = topology.wideIndices
+            ? ConvertConnectivity(rawData + c0, count, numPoints, topology.conn64.data() + c0)
+            : ConvertConnectivity(rawData + c0, count, numPoints, topology.conn32.data() + c0);
+        if (!ok) {
+            for (size_t e = begin; e < end; ++e) {
+                bool bad = false;
+                for (uint32_t k = 0; k < nodesPerElement; ++k) bad |= static_cast<uint64_t>(rawData[e * nodesPerElement + k]) >= numPoints;
+                if (!bad) continue;
+                size_t prev = firstBadElement.load();
+                while (e < prev && !firstBadElement.compare_exchange_weak(prev, e)) {}
+                break;
+            }
+        }
+    });
+
+    if (firstBadElement.load() != std::numeric_limits<size_t>::max()) {
+        size_t e = firstBadElement.load();
+        topology.Clear();
+        throw std::runtime_error("Topology element " + std::to_string(e) + " references a node outside geometry (" +
+                                 std::to_string(numPoints) + " points).");
+    }
+}
+
+uint8_t XdmfMeshLoader::GetXdmfTypeForTopologyName(const std::string& topologyType) {
+    // 单一类型拓扑只支持能提取面 / 边的类型
+    for (const auto& traits : kElementTraits) {
+        if (traits.dimension > 0 && topologyType == traits.name) return traits.type;
+    }
+    return 0;
+}
+
+int XdmfMeshLoader::GetNodeCountForXdmfType(uint8_t type) {
+    const ElementTraits* traits = ElementTraitsFor(type);
+    return traits ? traits->nodeCount : -1;  // -1: 未知类型
+}
+
+// ============ 顶点缓存优化 ================
+
+// 三角形索引缓冲区的重排和评估。表面按单元顺序输出时，相邻三角形在空间上经常不相邻，
+// GPU 的顶点后变换缓存命中率低，同一个顶点会被反复着色。
+
+struct VertexCacheStats {
+    double acmr = 0.0;  // 每个三角形平均缓存未命中次数，理想值约 0.5，最差 3
+    double atvr = 0.0;  // 着色次数 / 顶点数，理想值 1
+};
+
+// 模拟大小为 cacheSize 的 FIFO 顶点缓存
+inline VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16) {
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0) return stats;
+
+    // 记录每个顶点进入缓存的时刻，时刻差小于 cacheSize 即还在 FIFO 中
+    std::vector<size_t> cachedAt(vertexCount, std::numeric_limits<size_t>::max());
+    size_t misses = 0;
+    for (unsigned int v : indices) {
+        if (cachedAt[v] == std::numeric_limits<size_t>::max() || misses - cachedAt[v] >= cacheSize) {
+            cachedAt[v] = misses;
+            ++misses;
+        }
+    }
+    stats.acmr = static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+    stats.atvr = static_cast<double>(misses) / static_cast<double>(vertexCount);
+    return stats;
+}
+
+// Tipsify（Sander, Nehab, Barczak 2007）：围绕一个“扇心”顶点依次输出它的所有未输出三角形，
+// 再从刚输出的顶点里挑一个仍在缓存中、剩余三角形又不多的作为下一个扇心；无候选时从死胡同栈或按顺序找。
+// 时间复杂度与三角形数线性，顶点缓存大小 cacheSize 只影响挑选策略。
+// 返回 新三角形号 -> 原三角形号，逐三角形的数据据此同步重排。
+inline std::vector<uint32_t> OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return {};
+
+    // 顶点 -> 三角形邻接表（CSR）
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (unsigned int v : indices) ++liveTriangles[v];
+    std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<size_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) adjacency[cursor[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> order;
+    order.reserve(triangleCount);
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;  // 按顺序找下一个还有剩余三角形的顶点
+    long long fanning = 0;
+    while (fanning >= 0 && !indices.empty()) {
+        const unsigned int f = static_cast<unsigned int>(fanning);
+        candidates.clear();
+        for (size_t a = adjacencyStart[f]; a < adjacencyStart[f + 1]; ++a) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                const unsigned int v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+            emitted[t] = 1;
+            order.push_back(t);
+        }
+
+        // 优先选仍在缓存里、输出完剩余三角形后也不会被挤出去、且在缓存里待得最久的顶点
+        long long next = -1;
+        long long best = -1;
+        for (unsigned int v : candidates) {
+            if (liveTriangles[v] == 0) continue;
+            long long priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = static_cast<long long>(time - cacheTime[v]);
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0) {
+            while (!deadEnd.empty()) {
+                const unsigned int d = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[d] > 0) {
+                    next = d;
+                    break;
+                }
+            }
+        }
+        if (next < 0) {
+            while (cursor < vertexCount && liveTriangles[cursor] == 0) ++cursor;
+            if (cursor < vertexCount) next = static_cast<long long>(cursor);
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+    return order;
+}
+
+// 按顶点在索引缓冲区里第一次出现的顺序重排顶点，取顶点时内存访问基本是顺序的。
+// 多个索引缓冲区共用一份顶点时依次扫描，前面的缓冲区用到的顶点排在前面；没被引用的顶点被丢掉。
+// 索引原地改成新编号，返回 新编号 -> 原编号。
+inline std::vector<unsigned int> OptimizeVertexFetch(size_t vertexCount, std::initializer_list<std::vector<unsigned int>*> indexBuffers) {
+    constexpr unsigned int kUnmapped = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> remap(vertexCount, kUnmapped);
+    std::vector<unsigned int> order;
+
+    for (std::vector<unsigned int>* indices : indexBuffers) {
+        for (unsigned int& v : *indices) {
+            if (remap[v] == kUnmapped) {
+                remap[v] = static_cast<unsigned int>(order.size());
+                order.push_back(v);
+            }
+            v = remap[v];
+        }
+    }
+    return order;
+}
+
+// 过度绘制：从 ±X / ±Y / ±Z 六个方向做正交投影，软件光栅化到 resolution^2 的深度缓冲，
+// 按索引顺序绘制、深度测试 LESS，返回 通过深度测试的像素数 / 最终被覆盖的像素数，1 表示没有过度绘制。
+// cullBackFaces 时只画正面：体单元的表面按面表绕向朝外（见 kElementTraits 的 static_assert）；
+// 有二维单元时表面不封闭、绕向也没有内外之分，两面都画。只在 MeshBuildOptions::diagnostics 时调用。
+inline double AnalyzeOverdraw(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                              bool cullBackFaces, int resolution = 256) {
+    const size_t vertexCount = vertices.size() / 3;
+    if (vertexCount == 0 || indices.empty()) return 0.0;
+
+    std::array<float, 3> lo = { vertices[0], vertices[1], vertices[2] };
+    std::array<float, 3> hi = lo;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], vertices[v * 3 + k]);
+            hi[k] = std::max(hi[k], vertices[v * 3 + k]);
+        }
+    }
+    const float extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2], 1e-20f });
+
+    size_t shaded = 0, covered = 0;
+    std::vector<float> depth;
+    std::vector<std::array<float, 3>> projected(vertexCount);
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int sign = -1; sign <= 1; sign += 2) {
+            // 屏幕坐标取另外两个轴，深度沿 axis 方向
+            const int u = (axis + 1) % 3, w = (axis + 2) % 3;
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const float* p = &vertices[v * 3];
+                projected[v] = { (p[u] - lo[u]) / extent * (resolution - 1),
+                                 (p[w] - lo[w]) / extent * (resolution - 1),
+                                 sign * (p[axis] - lo[axis]) / extent };
+            }
+
+            depth.assign(static_cast<size_t>(resolution) * resolution, std::numeric_limits<float>::max());
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                const auto& a = projected[indices[t]];
+                const auto& b = projected[indices[t + 1]];
+                const auto& c = projected[indices[t + 2]];
+                // 屏幕 (u, w) 上的有向面积与法向的 axis 分量同号；视线沿 sign·axis，
+                // 剔除时只画法向朝相机的正面，封闭表面的背面不算重绘
+                const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+                if (area == 0.0f || (cullBackFaces && sign * area > 0.0f)) continue;
+
+                const int x0 = std::max(0, static_cast<int>(std::ceil(std::min({ a[0], b[0], c[0] }))));
+                const int x1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max({ a[0], b[0], c[0] }))));
+                const int y0 = std::max(0, static_cast<int>(std::ceil(std::min({ a[1], b[1], c[1] }))));
+                const int y1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max({ a[1], b[1], c[1] }))));
+                for (int y = y0; y <= y1; ++y) {
+                    for (int x = x0; x <= x1; ++x) {
+                        // 重心坐标，三个都非负即在三角形内（除以有向面积，与绕向无关）
+                        const float l0 = ((b[0] - x) * (c[1] - y) - (b[1] - y) * (c[0] - x)) / area;
+                        const float l1 = ((c[0] - x) * (a[1] - y) - (c[1] - y) * (a[0] - x)) / area;
+                        const float l2 = 1.0f - l0 - l1;
+                        if (l0 < 0.0f || l1 < 0.0f || l2 < 0.0f) continue;
+
+                        const float z = l0 * a[2] + l1 * b[2] + l2 * c[2];
+                        float& d = depth[static_cast<size_t>(y) * resolution + x];
+                        if (z < d) {
+                            if (d == std::numeric_limits<float>::max()) ++covered;
+                            d = z;
+                            ++shaded;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return covered ? static_cast<double>(shaded) / static_cast<double>(covered) : 0.0;
+}
+
+
+// ============ 顶点分块与量化 ================
+
+// 渲染用的顶点分成不超过 65536 个的块，索引只用 16 位（块内局部编号，绘制时用 BaseVertex 加上块的起始顶点）。
+// 表面三角形先按空间聚成小簇，每簇单独成块，块的包围盒就很紧，既用于视锥剔除，也用于量化。
+// 可选的压缩顶点格式：每块位置相对自己的包围盒量化成 16 位整数，第 4 个分量存块号，
+// 顶点着色器按块号查块表还原：pos = offset + q * scale，块内误差不超过包围盒边长 / 131070。
+// 还原参数不随 draw call 变，所有块可以在一次多重绘制里提交（见 DrawSubmitter）。
+
+// 共享顶点缓冲区中的一块
+struct VertexChunk {
+    uint32_t baseVertex = 0;   // 块的第一个顶点，块内索引都相对它
+    uint32_t vertexCount = 0;
+    float offset[3] = { 0.0f, 0.0f, 0.0f };  // 包围盒最小角，未量化的块为 0
+    float scale[3] = { 1.0f, 1.0f, 1.0f };   // 量化步长，未量化的块为 1
+    float boundsMin[3] = { 0.0f, 0.0f, 0.0f };  // 块内顶点的包围盒（还原后的坐标）
+    float boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// 索引缓冲区中引用同一块顶点的一段，一次 draw call
+struct DrawRange {
+    uint64_t firstIndex = 0;   // 以索引个数计
+    uint32_t indexCount = 0;
+    uint32_t chunk = 0;        // VertexChunk 的下标
+};
+
+// 一个共用顶点的索引缓冲区：输入 indices 每 primitiveSize 个组成一个图元（线 2，三角形 3），
+// 输出按块分组的 16 位索引和对应的绘制列表
+struct ChunkPass {
+    const std::vector<unsigned int>* indices = nullptr;
+    int primitiveSize = 3;
+    const std::vector<uint32_t>* segments = nullptr;  // 可选：这些图元号处必须另起一块（空间簇的起点）
+    std::vector<uint16_t> outIndices;
+    std::vector<DrawRange> outRanges;
+    std::vector<uint32_t> outPrimitiveOrder;  // 新图元号 -> 原图元号，按块分组会打乱图元顺序
+};
+
+struct ChunkedGeometry {
+    std::vector<float> vertices;              // 未量化：每个顶点 float xyz
+    std::vector<uint16_t> quantizedVertices;  // 量化：每个顶点 4 个 uint16（xyz + 块号）
+    std::vector<VertexChunk> chunks;
+    bool quantized = false;
+};
+
+// 把表面三角形按重心递归地沿最长轴从中位数处对半分，直到每簇不超过 maxTriangles 个，
+// 簇按递归顺序排列（空间上相邻的簇也相邻）。簇内保持原来的相对顺序，不破坏 Tipsify 的结果。
+// 返回 新三角形号 -> 原三角形号，clusterStarts 为每簇第一个三角形的新编号。
+inline std::vector<uint32_t> ClusterTriangles(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                                              size_t maxTriangles, std::vector<uint32_t>& clusterStarts) {
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<std::array<float, 3>> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int c = 0; c < 3; ++c) {
+            centroids[t][c] = (vertices[size_t(indices[t * 3]) * 3 + c] + vertices[size_t(indices[t * 3 + 1]) * 3 + c] +
+                               vertices[size_t(indices[t * 3 + 2]) * 3 + c]) / 3.0f;
+        }
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) order[t] = static_cast<uint32_t>(t);
+    clusterStarts.clear();
+
+    std::vector<std::pair<size_t, size_t>> stack;  // 待分的 [begin, end)，后进先出保证簇按递归顺序输出
+    if (triangleCount > 0) stack.push_back({ 0, triangleCount });
+    while (!stack.empty()) {
+        const auto [begin, end] = stack.back();
+        stack.pop_back();
+        if (end - begin <= maxTriangles) {
+            std::sort(order.begin() + begin, order.begin() + end);
+            clusterStarts.push_back(static_cast<uint32_t>(begin));
+            continue;
+        }
+
+        std::array<float, 3> lo = centroids[order[begin]], hi = lo;
+        for (size_t i = begin; i < end; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                lo[c] = std::min(lo[c], centroids[order[i]][c]);
+                hi[c] = std::max(hi[c], centroids[order[i]][c]);
+            }
+        }
+        int axis = 0;
+        for (int c = 1; c < 3; ++c) if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        stack.push_back({ mid, end });
+        stack.push_back({ begin, mid });
+    }
+    return order;
+}
+
+// vertices 是紧密排列的 float xyz，passes 依次装块：图元的顶点都已经在同一块里就直接用那一块
+// （线框的边大多落在某个表面三角形所在的块里），否则放进当前块，装不下或到了新的空间簇就另起一块；
+// 跨块的顶点在几块里各存一份。顶点已按首次使用排序时（OptimizeVertexFetch 之后），每块的顶点基本连续，重复很少。
+// 每个顶点记住第一次放进的块和最近一次放进的块：只记最近一次的话，一条跨块的边把端点复制进当前块后，
+// 这些端点的其余边在原来的块里就找不到了，会连锁地全部挤进当前块。
+// 量化时块数超过 kMaxQuantizedChunks 就退回 float 顶点（结果的 quantizedVertices 为空）。
+inline ChunkedGeometry BuildVertexChunks(const std::vector<float>& vertices, std::vector<ChunkPass>& passes, bool quantize) {
+    constexpr size_t kMaxChunkVertices = 65536;
+    // 块号存在 16 位分量里；块表每块 2 个 texel，规范只保证缓冲区纹理有 65536 个
+    constexpr size_t kMaxQuantizedChunks = 32768;
+    constexpr uint32_t kNoChunk = std::numeric_limits<uint32_t>::max();
+    const size_t vertexCount = vertices.size() / 3;
+
+    // 顶点 v 的两个位置：[2v] 第一次放进的块，[2v + 1] 最近一次放进的块，以及在该块中的编号
+    std::vector<uint32_t> slotChunk(vertexCount * 2, kNoChunk);
+    std::vector<uint16_t> slotLocal(vertexCount * 2);
+    std::vector<std::vector<unsigned int>> chunkVertices;  // 每块的顶点，按局部编号排列
+
+    auto findSlot = [&](unsigned int v, uint32_t chunk) -> int {
+        if (slotChunk[size_t(v) * 2] == chunk) return 0;
+        if (slotChunk[size_t(v) * 2 + 1] == chunk) return 1;
+        return -1;
+    };
+    auto localIndex = [&](unsigned int v, uint32_t chunk) { return slotLocal[size_t(v) * 2 + findSlot(v, chunk)]; };
+    // 图元的所有顶点都在 chunk 里
+    auto containsAll = [&](const unsigned int* prim, int count, uint32_t chunk) {
+        if (chunk == kNoChunk) return false;
+        for (int k = 0; k < count; ++k) {
+            if (findSlot(prim[k], chunk) < 0) return false;
+        }
+        return true;
+    };
+
+    for (ChunkPass& pass : passes) {
+        const std::vector<unsigned int>& indices = *pass.indices;
+        const int primitiveSize = pass.primitiveSize;
+        std::vector<std::vector<uint16_t>> byChunk(chunkVertices.size());
+        std::vector<std::vector<uint32_t>> primitivesByChunk(chunkVertices.size());
+        size_t nextSegment = 0;
+        // 每个批次放不进已有块的图元从新块开始放，不混进上一批次的空间簇
+        bool needNewChunk = true;
+
+        for (size_t p = 0; p + primitiveSize <= indices.size(); p += primitiveSize) {
+            const size_t primitive = p / primitiveSize;
+            // 新簇的第一个图元不沿用旧块
+            bool segmentStart = false;
+            if (pass.segments && nextSegment < pass.segments->size() && (*pass.segments)[nextSegment] == primitive) {
+                ++nextSegment;
+                segmentStart = true;
+                needNewChunk = true;
+            }
+
+            // 优先用第一个顶点最近放进的块，其次是它第一次放进的块
+            uint32_t chunk = kNoChunk;
+            const unsigned int* prim = &indices[p];
+            if (!segmentStart) {
+                if (containsAll(prim, primitiveSize, slotChunk[size_t(prim[0]) * 2 + 1])) chunk = slotChunk[size_t(prim[0]) * 2 + 1];
+                else if (containsAll(prim, primitiveSize, slotChunk[size_t(prim[0]) * 2])) chunk = slotChunk[size_t(prim[0]) * 2];
+            }
+
+            if (chunk == kNoChunk) {
+                // 保守估计：图元的顶点全是新的
+                if (needNewChunk || chunkVertices.back().size() + primitiveSize > kMaxChunkVertices) {
+                    chunkVertices.emplace_back();
+                    needNewChunk = false;
+                }
+                chunk = static_cast<uint32_t>(chunkVertices.size() - 1);
+                for (int k = 0; k < primitiveSize; ++k) {
+                    const unsigned int v = prim[k];
+                    if (findSlot(v, chunk) < 0) {
+                        const size_t slot = size_t(v) * 2 + (slotChunk[size_t(v) * 2] == kNoChunk ? 0 : 1);
+                        slotChunk[slot] = chunk;
+                        slotLocal[slot] = static_cast<uint16_t>(chunkVertices[chunk].size());
+                        chunkVertices[chunk].push_back(v);
+                    }
+                }
+            }
+
+            if (byChunk.size() <= chunk) {
+                byChunk.resize(chunk + 1);
+                primitivesByChunk.resize(chunk + 1);
+            }
+            for (int k = 0; k < primitiveSize; ++k) byChunk[chunk].push_back(localIndex(prim[k], chunk));
+            primitivesByChunk[chunk].push_back(static_cast<uint32_t>(primitive));
+        }
+
+        pass.outIndices.clear();
+        pass.outRanges.clear();
+        pass.outPrimitiveOrder.clear();
+        pass.outIndices.reserve(indices.size());
+        pass.outPrimitiveOrder.reserve(indices.size() / primitiveSize);
+        for (size_t c = 0; c < byChunk.size(); ++c) {
+            if (byChunk[c].empty()) continue;
+            pass.outRanges.push_back({ pass.outIndices.size(), static_cast<uint32_t>(byChunk[c].size()), static_cast<uint32_t>(c) });
+            pass.outIndices.insert(pass.outIndices.end(), byChunk[c].begin(), byChunk[c].end());
+            pass.outPrimitiveOrder.insert(pass.outPrimitiveOrder.end(), primitivesByChunk[c].begin(), primitivesByChunk[c].end());
+        }
+    }
+
+    if (quantize && chunkVertices.size() > kMaxQuantizedChunks) {
+        std::cerr << "Too many render chunks to quantize (" << chunkVertices.size() << " > " << kMaxQuantizedChunks
+                  << "), using float vertices" << std::endl;
+        quantize = false;
+    }
+
+    ChunkedGeometry out;
+    out.quantized = quantize;
+    size_t baseVertex = 0;
+    for (const auto& list : chunkVertices) {
+        VertexChunk chunk;
+        chunk.baseVertex = static_cast<uint32_t>(baseVertex);
+        chunk.vertexCount = static_cast<uint32_t>(list.size());
+        baseVertex += list.size();
+        float lo[3], hi[3];
+        for (int c = 0; c < 3; ++c) lo[c] = hi[c] = vertices[size_t(list[0]) * 3 + c];
+        for (unsigned int v : list) {
+            for (int c = 0; c < 3; ++c) {
+                lo[c] = std::min(lo[c], vertices[size_t(v) * 3 + c]);
+                hi[c] = std::max(hi[c], vertices[size_t(v) * 3 + c]);
+            }
+        }
+        for (int c = 0; c < 3; ++c) {
+            chunk.boundsMin[c] = lo[c];
+            chunk.boundsMax[c] = hi[c];
+        }
+
+        if (!quantize) {
+            for (unsigned int v : list) out.vertices.insert(out.vertices.end(), &vertices[size_t(v) * 3], &vertices[size_t(v) * 3] + 3);
+            out.chunks.push_back(chunk);
+            continue;
+        }
+
+        for (int c = 0; c < 3; ++c) {
+            chunk.offset[c] = lo[c];
+            chunk.scale[c] = (hi[c] - lo[c]) / 65535.0f;
+        }
+        for (unsigned int v : list) {
+            for (int c = 0; c < 3; ++c) {
+                const float step = chunk.scale[c];
+                const long q = step > 0.0f ? std::lround((vertices[size_t(v) * 3 + c] - lo[c]) / step) : 0;
+                out.quantizedVertices.push_back(static_cast<uint16_t>(std::clamp(q, 0L, 65535L)));
+            }
+            out.quantizedVertices.push_back(static_cast<uint16_t>(out.chunks.size()));
+        }
+        out.chunks.push_back(chunk);
+    }
+    return out;
+}
+
+
+// ============ 视锥剔除 ================
+
+// 视锥的 6 个平面，直接由 MVP 矩阵的行组合得到（Gribb & Hartmann），法向朝内，不需要归一化
+struct Frustum {
+    enum Result { Outside, Intersect, Inside };
+
+    std::array<glm::vec4, 6> planes;
+
+    explicit Frustum(const glm::mat4& mvp) {
+        const glm::vec4 row3(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec4 row(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+            planes[i * 2] = row3 + row;
+            planes[i * 2 + 1] = row3 - row;
+        }
+    }
+
+    // 包围盒沿法向最远的角在某个平面外侧就整个在外面；最近的角都在内侧就整个在里面
+    Result Classify(const float lo[3], const float hi[3]) const {
+        Result result = Inside;
+        for (const glm::vec4& p : planes) {
+            const float farthest = p.x * (p.x >= 0.0f ? hi[0] : lo[0]) + p.y * (p.y >= 0.0f ? hi[1] : lo[1]) +
+                              p.z * (p.z >= 0.0f ? hi[2] : lo[2]) + p.w;
+            if (farthest < 0.0f) return Outside;
+            const float nearest = p.x * (p.x >= 0.0f ? lo[0] : hi[0]) + p.y * (p.y >= 0.0f ? lo[1] : hi[1]) +
+                               p.z * (p.z >= 0.0f ? lo[2] : hi[2]) + p.w;
+            if (nearest < 0.0f) result = Intersect;
+        }
+        return result;
+    }
+};
+
+// 顶点块包围盒上的层次包围盒。按块的中心沿最长轴从中位数处对半分，每个节点覆盖 items 中连续的一段，
+// 完全在视锥内的子树不必再往下测试，整段标记为可见。
+class ChunkBvh {
+public:
+    void Build(const std::vector<VertexChunk>& chunks) {
+        nodes.clear();
+        items.resize(chunks.size());
+        for (size_t c = 0; c < chunks.size(); ++c) items[c] = static_cast<uint32_t>(c);
+        if (!chunks.empty()) BuildNode(chunks, 0, static_cast<uint32_t>(chunks.size()));
+    }
+
+    // visible[c] = 1 表示第 c 块与视锥相交，返回可见块数
+    size_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const {
+        visible.assign(items.size(), 0);
+        size_t count = 0;
+        std::vector<uint32_t> stack;
+        if (!nodes.empty()) stack.push_back(0);
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[index];
+            const Frustum::Result result = frustum.Classify(node.lo, node.hi);
+            if (result == Frustum::Outside) continue;
+            if (result == Frustum::Inside || node.right == 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) visible[items[i]] = 1;
+                count += node.count;
+                continue;
+            }
+            stack.push_back(node.right);
+            stack.push_back(index + 1);
+        }
+        return count;
+    }
+
+private:
+    static constexpr uint32_t kLeafSize = 4;
+
+    struct Node {
+        float lo[3], hi[3];
+        uint32_t first = 0, count = 0;  // 覆盖 items[first, first + count)
+        uint32_t right = 0;             // 右子节点，左子节点紧跟在自己后面；0 表示叶子
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;  // 块号，按树的顺序排列
+
+    void BuildNode(const std::vector<VertexChunk>& chunks, uint32_t first, uint32_t count) {
+        const uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        Node node;
+        node.first = first;
+        node.count = count;
+        for (int c = 0; c < 3; ++c) {
+            node.lo[c] = std::numeric_limits<float>::max();
+            node.hi[c] = std::numeric_limits<float>::lowest();
+        }
+        for (uint32_t i = first; i < first + count; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                node.lo[c] = std::min(node.lo[c], chunks[items[i]].boundsMin[c]);
+                node.hi[c] = std::max(node.hi[c], chunks[items[i]].boundsMax[c]);
+            }
+        }
+
+        if (count > kLeafSize) {
+            int axis = 0;
+            for (int c = 1; c < 3; ++c) if (node.hi[c] - node.lo[c] > node.hi[axis] - node.lo[axis]) axis = c;
+            auto center = [&](uint32_t chunk) { return chunks[chunk].boundsMin[axis] + chunks[chunk].boundsMax[axis]; };
+            const uint32_t half = count / 2;
+            std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                             [&](uint32_t a, uint32_t b) { return center(a) < center(b); });
+            BuildNode(chunks, first, half);
+            node.right = static_cast<uint32_t>(nodes.size());
+            BuildNode(chunks, first + half, count - half);
+        }
+        nodes[index] = node;
+    }
+};
 
-    tinyxml2::XMLElement* domain = root->FirstChildElement("Domain");
-    if (!domain) throw std::runtime_error("Domain element not found");
 
-    tinyxml2::XMLElement* grid = domain->FirstChildElement("Grid");
-    if (!grid) throw std::runtime_error("Grid element not found");
+// ============ 表面简化 ================
 
-    // 解析 Geometry 节点
-    tinyxml2::XMLElement* geometry = grid->FirstChildElement("Geometry");
-    if (!geometry) throw std::runtime_error("Geometry element not found");
+// 表面块的一级简化，索引接在原始三角形后面；同一段的各级从细到粗相邻存放
+struct LodLevel {
+    uint64_t firstIndex = 0;  // 以索引个数计
+    uint32_t indexCount = 0;
+    uint32_t chunk = 0;
+    float error = 0.0f;       // 相对原始表面的偏离估计（模型单位）
+    uint32_t range = 0;       // 对应原始三角形的 DrawRange 在 Mesh::ranges 中的下标
+};
 
-    std::string geomHdf5Path;
-    std::vector<hsize_t> geomDims;
-    tinyxml2::XMLElement* geomDataItem = geometry->FirstChildElement("DataItem");
-    if (!geomDataItem) throw std::runtime_error("Geometry DataItem not found");
+struct SimplifiedLevel {
+    std::vector<uint16_t> indices;
+    float error = 0.0f;
+};
 
-    ParseDataItem(geomDataItem, geomHdf5Path, geomDims);
+// 二次误差度量：若干平面的距离平方和，存对称 4×4 矩阵的上三角
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
 
-    if (geomDims.size() != 2 || geomDims[1] != 3) {
-        throw std::runtime_error("Geometry dimensions invalid, expected Nx3.");
+    void AddPlane(double a, double b, double c, double d) {
+        xx += a * a; xy += a * b; xz += a * c; xw += a * d;
+        yy += b * b; yz += b * c; yw += b * d;
+        zz += c * c; zw += c * d;
+        ww += d * d;
     }
-    LoadGeometry(geomHdf5Path, geomDims[0]);
-
-    // 解析 Topology 节点
-    tinyxml2::XMLElement* topology = grid->FirstChildElement("Topology");
-    if (!topology) throw std::runtime_error("Topology element not found");
 
-    const char* topoType = topology->Attribute("TopologyType");
-    if (!topoType || std::string(topoType) != "Mixed") {
-        throw std::runtime_error("Only Mixed topology supported.");
+    Quadric& operator+=(const Quadric& o) {
+        xx += o.xx; xy += o.xy; xz += o.xz; xw += o.xw;
+        yy += o.yy; yz += o.yz; yw += o.yw;
+        zz += o.zz; zw += o.zw;
+        ww += o.ww;
+        return *this;
     }
 
-    tinyxml2::XMLElement* topoDataItem = topology->FirstChildElement("DataItem");
-    if (!topoDataItem) throw std::runtime_error("Topology DataItem not found");
+    double Evaluate(double x, double y, double z) const {
+        return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x +
+               yy * y * y + 2 * yz * y * z + 2 * yw * y +
+               zz * z * z + 2 * zw * z + ww;
+    }
+};
 
-    std::string topoHdf5Path;
-    std::vector<hsize_t> topoDims;
-    ParseDataItem(topoDataItem, topoHdf5Path, topoDims);
+// 一块表面的 LOD 链：按二次误差从小到大做半边折叠，每次把一个顶点并到相邻顶点上，不产生新顶点，
+// 所以每一级只是同一批块内顶点上的另一份索引。
+// 块内只被一个三角形用到的边（块的边界、网格本身的开放边界）、非流形边、两侧 regions 不同的边（材料分界），
+// 它们的端点都不动：相邻块选了不同的级别，接缝上的顶点仍然一致，不会裂开。
+// 每级的目标是上一级三角形数的一半，减不到 3/4 以下就停止。positions 为块内顶点 xyz，regions 可以为空。
+std::vector<SimplifiedLevel> SimplifyChunk(const std::vector<float>& positions, const uint16_t* indices,
+                                           size_t triangleCount, const uint32_t* regions, int maxLevels) {
+    const size_t vertexCount = positions.size() / 3;
+    std::vector<std::array<uint32_t, 3>> tris(triangleCount);
+    std::vector<uint8_t> alive(triangleCount, 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) tris[t][k] = indices[t * 3 + k];
+    }
 
-    LoadMixedTopology(topoHdf5Path);
-}
+    auto position = [&](uint32_t v) { return &positions[size_t(v) * 3]; };
+    auto normal = [&](uint32_t a, uint32_t b, uint32_t c, double n[3]) {
+        const float* p = position(a);
+        const float* q = position(b);
+        const float* r = position(c);
+        const double u[3] = { double(q[0]) - p[0], double(q[1]) - p[1], double(q[2]) - p[2] };
+        const double w[3] = { double(r[0]) - p[0], double(r[1]) - p[1], double(r[2]) - p[2] };
+        n[0] = u[1] * w[2] - u[2] * w[1];
+        n[1] = u[2] * w[0] - u[0] * w[2];
+        n[2] = u[0] * w[1] - u[1] * w[0];
+        return std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    };
 
-void XdmfMeshLoader::ParseDataItem(tinyxml2::XMLElement* dataItem, std::string& hdf5Path, std::vector<hsize_t>& dims) {
-    const char* dimsStr = dataItem->Attribute("Dimensions");
-    if (!dimsStr) throw std::runtime_error("DataItem Dimensions attribute missing.");
+    // 锁定的顶点；按 (较小端点 << 16 | 较大端点) 分组数每条边的三角形
+    std::vector<uint8_t> locked(vertexCount, 0);
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> edges;  // (边, 三角形)
+        edges.reserve(triangleCount * 3);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = tris[t][k], b = tris[t][(k + 1) % 3];
+                edges.emplace_back(std::min(a, b) << 16 | std::max(a, b), static_cast<uint32_t>(t));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j].first == edges[i].first) ++j;
+            if (j - i != 2 || (regions && regions[edges[i].second] != regions[edges[i + 1].second])) {
+                locked[edges[i].first >> 16] = 1;
+                locked[edges[i].first & 0xFFFF] = 1;
+            }
+            i = j;
+        }
+    }
 
-    // 解析 Dimensions 格式 "30574 3" 为 vector<hsize_t>
-    dims.clear();
-    std::stringstream ss(dimsStr);
-    std::string token;
-    while (ss >> token) {
-        dims.push_back(static_cast<hsize_t>(std::stoull(token)));
+    // 每个顶点累加相邻三角形所在平面（不按面积加权，代价就是到这些平面的距离平方和）
+    std::vector<Quadric> quadrics(vertexCount);
+    size_t current = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        double n[3];
+        const double length = normal(tris[t][0], tris[t][1], tris[t][2], n);
+        if (length <= 0.0) {
+            alive[t] = 0;  // 退化三角形直接丢掉
+            continue;
+        }
+        for (double& c : n) c /= length;
+        const float* p = position(tris[t][0]);
+        const double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+        for (int k = 0; k < 3; ++k) quadrics[tris[t][k]].AddPlane(n[0], n[1], n[2], d);
+        ++current;
     }
 
-    const char* format = dataItem->Attribute("Format");
-    if (!format || std::string(format) != "HDF") {
-        throw std::runtime_error("Only HDF format supported.");
+    // 顶点 -> 相邻三角形，折叠时把被删顶点的三角形挪给目标顶点；删掉的三角形留在表里，遍历时跳过
+    std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (alive[t]) for (uint32_t v : tris[t]) adjacency[v].push_back(static_cast<uint32_t>(t));
     }
+    auto contains = [&](uint32_t t, uint32_t v) { return tris[t][0] == v || tris[t][1] == v || tris[t][2] == v; };
+
+    // u 并到 v：两者的共同邻点必须恰好是共享 uv 的三角形的第三个顶点（否则会产生非流形），
+    // 其余以 u 为顶点的三角形换成 v 以后不能翻面或退化
+    std::vector<uint32_t> ringU, ringV;
+    auto collectRing = [&](uint32_t v, uint32_t skip, std::vector<uint32_t>& ring) {
+        ring.clear();
+        for (uint32_t t : adjacency[v]) {
+            if (!alive[t]) continue;
+            for (uint32_t w : tris[t]) if (w != v && w != skip) ring.push_back(w);
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    };
+    auto canCollapse = [&](uint32_t u, uint32_t v) {
+        size_t shared = 0;
+        for (uint32_t t : adjacency[u]) shared += alive[t] && contains(t, v);
+        collectRing(u, v, ringU);
+        collectRing(v, u, ringV);
+        size_t common = 0;
+        for (size_t i = 0, j = 0; i < ringU.size() && j < ringV.size();) {
+            if (ringU[i] < ringV[j]) ++i;
+            else if (ringV[j] < ringU[i]) ++j;
+            else { ++common; ++i; ++j; }
+        }
+        if (common != shared) return false;
+
+        for (uint32_t t : adjacency[u]) {
+            if (!alive[t] || contains(t, v)) continue;
+            std::array<uint32_t, 3> moved = tris[t];
+            for (uint32_t& w : moved) if (w == u) w = v;
+            double before[3], after[3];
+            const double lengthBefore = normal(tris[t][0], tris[t][1], tris[t][2], before);
+            const double lengthAfter = normal(moved[0], moved[1], moved[2], after);
+            const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+            if (lengthAfter <= 1e-6 * lengthBefore || dot <= 0.0) return false;
+        }
+        return true;
+    };
 
-    const char* text = dataItem->GetText();
-    if (!text) throw std::runtime_error("DataItem text missing (expected HDF file path and dataset).");
+    // 每个可动的顶点把并到各个邻点的代价都放进堆里，合法性到出堆时再查；顶点的邻域或二次误差一变，
+    // version 加一，它之前入堆的都作废
+    struct Candidate {
+        double cost;   // 排序用：二次误差加一点边长，平面上误差都是 0 时先折短边，避免折成高度数的扇形
+        double error;  // 二次误差
+        uint32_t from, to, version;
+        bool operator>(const Candidate& o) const { return cost > o.cost; }
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+    std::vector<uint32_t> version(vertexCount, 0);
+    constexpr double kLengthWeight = 1e-3;
+    auto evaluate = [&](uint32_t u) {
+        ++version[u];
+        if (locked[u]) return;
+        collectRing(u, u, ringU);
+        for (uint32_t w : ringU) {
+            Quadric q = quadrics[u];
+            q += quadrics[w];
+            const float* p = position(w);
+            const float* o = position(u);
+            const double error = std::max(0.0, q.Evaluate(p[0], p[1], p[2]));
+            const double length2 = (double(p[0]) - o[0]) * (double(p[0]) - o[0]) + (double(p[1]) - o[1]) * (double(p[1]) - o[1]) +
+                                   (double(p[2]) - o[2]) * (double(p[2]) - o[2]);
+            heap.push({ error + kLengthWeight * length2, error, u, w, version[u] });
+        }
+    };
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        if (!adjacency[v].empty()) evaluate(v);
+    }
 
-    // text格式一般是 "../data/model_3d.h5:/data0"
-    std::string fullStr(text);
-    size_t pos = fullStr.find(':');
-    if (pos == std::string::npos) throw std::runtime_error("HDF5 dataset path invalid.");
+    std::vector<SimplifiedLevel> levels;
+    double maxCost = 0.0;
+    std::vector<uint32_t> affected;
+    for (int level = 0; level < maxLevels && current > 1; ++level) {
+        const size_t target = current / 2;
+        size_t remaining = current;
+        while (remaining > target && !heap.empty()) {
+            const Candidate c = heap.top();
+            heap.pop();
+            if (c.version != version[c.from] || !canCollapse(c.from, c.to)) continue;
+
+            affected.clear();
+            for (uint32_t t : adjacency[c.from]) {
+                if (!alive[t]) continue;
+                for (uint32_t w : tris[t]) if (w != c.from) affected.push_back(w);
+                if (contains(t, c.to)) {
+                    alive[t] = 0;
+                    --remaining;
+                } else {
+                    for (uint32_t& w : tris[t]) if (w == c.from) w = c.to;
+                    adjacency[c.to].push_back(t);
+                }
+            }
+            std::vector<uint32_t>().swap(adjacency[c.from]);
+            ++version[c.from];
+            quadrics[c.to] += quadrics[c.from];
+            maxCost = std::max(maxCost, c.error);
+
+            auto& list = adjacency[c.to];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return !alive[t]; }), list.end());
+            // 目标顶点的二次误差变了，它一环内所有顶点的候选都要重算
+            collectRing(c.to, c.to, ringV);
+            affected.insert(affected.end(), ringV.begin(), ringV.end());
+            std::sort(affected.begin(), affected.end());
+            affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+            for (uint32_t w : affected) evaluate(w);
+        }
+        if (remaining * 4 > current * 3) break;
 
-    hdf5Path = fullStr.substr(0, pos) + ":" + fullStr.substr(pos + 1);
+        SimplifiedLevel out;
+        out.indices.reserve(remaining * 3);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (alive[t]) for (uint32_t v : tris[t]) out.indices.push_back(static_cast<uint16_t>(v));
+        }
+        // 代价是到累加的各平面的距离平方和，开方不小于到其中任何一个原始平面的距离
+        out.error = static_cast<float>(std::sqrt(maxCost));
+        levels.push_back(std::move(out));
+        current = remaining;
+    }
+    return levels;
 }
 
-void XdmfMeshLoader::LoadGeometry(const std::string& hdf5Path, hsize_t numPoints) {
-    // hdf5Path 格式: "../data/model_3d.h5:/data0"
-    size_t pos = hdf5Path.find(':');
-    if (pos == std::string::npos) throw std::runtime_error("Invalid hdf5Path in LoadGeometry");
 
-    std::string fileName = hdf5Path.substr(0, pos);
-    std::string datasetName = hdf5Path.substr(pos + 1);
+// ============ 渲染网格缓存 ================
 
-    // 使用 HDF5 API 读取数据到 geometry 中
-    hid_t file_id = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0) throw std::runtime_error("Failed to open HDF5 file for geometry.");
+// 影响提取结果的选项，全部参与缓存键的计算
+// 线框包含哪些边
+enum class EdgeMode {
+    All,       // 所有单元的棱边（去重），包括被表面挡住的内部边
+    Boundary   // 只有边界表面上的边（四边形面不画对角线）
+};
 
-    hid_t dataset_id = H5Dopen(file_id, datasetName.c_str(), H5P_DEFAULT);
-    if (dataset_id < 0) {
-        H5Fclose(file_id);
-        throw std::runtime_error("Failed to open dataset for geometry.");
+struct MeshBuildOptions {
+    bool buildFaces = true;
+    bool buildLines = true;
+    bool singlePrecision = false;  // 见 XdmfMeshLoader::singlePrecision，顶点是相对 origin 的坐标
+    EdgeMode edgeMode = EdgeMode::Boundary;
+    bool optimizeVertexCache = true;  // 表面三角形按顶点缓存重排（Tipsify），顶点按首次使用顺序重排
+    // 大于 0 时（Boundary 模式）只保留特征边：相邻两个表面的法向夹角超过该角度（度），
+    // 以及开放边界、非流形处不是恰好两个面共享的边
+    float creaseAngle = 0.0f;
+    bool quantizePositions = false;  // 顶点位置按块量化成 16 位、索引用 16 位，见 QuantizePositions
+    int lodLevels = 0;               // 每个表面块最多预先简化几级，见 SimplifyChunk
+    std::string materialAttribute = "ansys_material_type";  // 单元材料号，简化时材料分界保持不动
+    // 输出顶点缓存命中率、软件光栅化估计的重绘率等诊断信息。光栅化要把整个表面从 6 个方向各画一遍，
+    // 大模型上很慢，默认关；不影响提取结果，所以不进缓存键
+    bool diagnostics = false;
+
+    std::string Key() const {
+        std::ostringstream ss;
+        ss << "faces=" << buildFaces << ";lines=" << buildLines << ";single=" << singlePrecision
+           << ";edges=" << static_cast<int>(edgeMode) << ";crease=" << creaseAngle
+           << ";vcache=" << optimizeVertexCache << ";quantize=" << quantizePositions
+           << ";lod=" << lodLevels << ";material=" << materialAttribute;
+        return ss.str();
     }
+};
 
-    geometry.resize(numPoints);
+// 提取好的顶点 / 索引缓冲区的二进制缓存，布局方便直接 mmap 后上传 GPU：
+//   Header | SectionEntry[sectionCount] | key 字符串 | 各段数据（按 16 字节对齐）
+// 缓存键包含 XDMF 路径、XDMF 和它引用的每个 .h5 文件的修改时间与大小，以及提取选项；
+// 任何一项变化，键就对不上，调用方重新生成缓存。
+class MeshCache {
+public:
+    enum SectionId : uint32_t {
+        Vertices          = 1,   // 面和线共用的 float xyz
+        QuantizedVertices = 2,   // quantizePositions 时代替 Vertices（块太多时仍是 Vertices）
+        VertexChunks      = 3,
+        FaceIndices       = 4,   // 16 位块内索引
+        FaceRanges        = 5,
+        FaceEdgeMasks     = 6,   // 每个表面三角形一个字节，见 Mesh::edge_masks
+        LineIndices       = 7,
+        LineRanges        = 8,
+        Origin            = 9,   // 3 个 double，顶点坐标加上它才是原始坐标
+        FaceLods          = 10   // 表面各段的简化级别，索引在 FaceIndices 里
+    };
 
-    // 创建内存空间与文件空间
-    hsize_t dims[2] = {numPoints, 3};
-    hid_t memspace = H5Screate_simple(2, dims, NULL);
+    struct SectionData {
+        SectionId id;
+        uint32_t elementSize;
+        const void* data;
+        uint64_t count;
+    };
 
-    // 读取数据
-    herr_t status = H5Dread(dataset_id, H5T_NATIVE_DOUBLE, memspace, H5S_ALL, H5P_DEFAULT, geometry.data());
-    if (status < 0) {
-        H5Dclose(dataset_id);
-        H5Fclose(file_id);
-        H5Sclose(memspace);
-        throw std::runtime_error("Failed to read geometry data.");
+    static std::string PathFor(const std::string& xdmfFilePath) {
+        return xdmfFilePath + ".meshcache";
     }
 
-    H5Dclose(dataset_id);
-    H5Fclose(file_id);
-    H5Sclose(memspace);
-}
+    static std::string KeyFor(const std::string& xdmfFilePath, const MeshBuildOptions& options) {
+        std::ostringstream key;
+        key << "xdmf=" << std::filesystem::absolute(xdmfFilePath).lexically_normal().string() << ";" << FileStamp(xdmfFilePath);
+        for (const auto& fileName : XdmfMeshLoader::ReferencedFiles(xdmfFilePath)) {
+            key << "h5=" << std::filesystem::absolute(fileName).lexically_normal().string() << ";" << FileStamp(fileName);
+        }
+        key << options.Key();
+        return key.str();
+    }
 
-void XdmfMeshLoader::LoadMixedTopology(const std::string& hdf5Path) {
-    // hdf5Path 格式: "../data/model_3d.h5:/data1"
-    size_t pos = hdf5Path.find(':');
-    if (pos == std::string::npos) throw std::runtime_error("Invalid hdf5Path in LoadMixedTopology");
+    // 打开并校验缓存，版本或键不一致时返回 false
+    bool Open(const std::string& cachePath, const std::string& key) {
+        file.reset();
+        sections.clear();
+        if (!std::filesystem::exists(cachePath)) return false;
 
-    std::string fileName = hdf5Path.substr(0, pos);
-    std::string datasetName = hdf5Path.substr(pos + 1);
+        try {
+            file = std::make_shared<MappedFile>(cachePath);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return false;
+        }
 
-    // 打开文件和数据集
-    hid_t file_id = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0) throw std::runtime_error("Failed to open HDF5 file for topology.");
+        const uint8_t* base = file->data();
+        Header header;
+        if (file->size() < sizeof(Header)) return Reject();
+        std::memcpy(&header, base, sizeof(Header));
+        if (std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0 || header.version != kVersion ||
+            header.fileSize != file->size()) {
+            return Reject();
+        }
 
-    hid_t dataset_id = H5Dopen(file_id, datasetName.c_str(), H5P_DEFAULT);
-    if (dataset_id < 0) {
-        H5Fclose(file_id);
-        throw std::runtime_error("Failed to open dataset for topology.");
-    }
+        const uint64_t tableEnd = sizeof(Header) + uint64_t(header.sectionCount) * sizeof(SectionEntry);
+        if (tableEnd + header.keyLength > file->size()) return Reject();
+        if (std::string(reinterpret_cast<const char*>(base + tableEnd), header.keyLength) != key) return Reject();
 
-    // 获取数据集尺寸，读取一维 int64_t 数组
-    hid_t space = H5Dget_space(dataset_id);
-    int ndims = H5Sget_simple_extent_ndims(space);
-    if (ndims != 1) {
-        H5Sclose(space);
-        H5Dclose(dataset_id);
-        H5Fclose(file_id);
-        throw std::runtime_error("Topology data should be 1D.");
+        for (uint32_t i = 0; i < header.sectionCount; ++i) {
+            SectionEntry entry;
+            std::memcpy(&entry, base + sizeof(Header) + i * sizeof(SectionEntry), sizeof(SectionEntry));
+            if (entry.offset + entry.count * entry.elementSize > file->size()) return Reject();
+            sections.push_back(entry);
+        }
+        return true;
     }
 
-    hsize_t dims;
-    H5Sget_simple_extent_dims(space, &dims, NULL);
-
-    // 读取全部数据
-    std::vector<int64_t> rawData(dims);
-    herr_t status = H5Dread(dataset_id, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, rawData.data());
-    if (status < 0) {
-        H5Sclose(space);
-        H5Dclose(dataset_id);
-        H5Fclose(file_id);
-        throw std::runtime_error("Failed to read topology data.");
+    // 取一段数据的只读指针，指向映射内存；没有这一段时返回 nullptr
+    template <typename T>
+    const T* Section(SectionId id, size_t& count) const {
+        for (const auto& entry : sections) {
+            if (entry.id == id && entry.elementSize == sizeof(T)) {
+                count = static_cast<size_t>(entry.count);
+                return reinterpret_cast<const T*>(file->data() + entry.offset);
+            }
+        }
+        count = 0;
+        return nullptr;
     }
 
-    H5Sclose(space);
-    H5Dclose(dataset_id);
-    H5Fclose(file_id);
-
-    // 清空旧数据
-    mixedTopology.clear();
-
-    // Mixed拓扑格式：
-    // 数据中，前一个元素是类型标识符 type，
-    // 后面紧跟该单元的节点索引，节点个数通过 type 得到
-    
+    // 小段数据（块表之类）复制出来，没有这一段时返回空数组
+    template <typename T>
+    std::vector<T> SectionCopy(SectionId id) const {
+        size_t count = 0;
+        const T* data = Section<T>(id, count);
+        return data ? std::vector<T>(data, data + count) : std::vector<T>();
+    }
 
-    size_t i = 0;
-    while (i < rawData.size()) {
-        int type = static_cast<int>(rawData[i]);
-        int nodeCount = GetNodeCountForXdmfType(type);
-        if (nodeCount <= 0) {
-            // Debug use
-            for (size_t k = i - 20; k < std::min<size_t>(i + 20, rawData.size()); ++k) {
-                std::cout << "rawData[" << k << "] = " << rawData[k] << std::endl;
+    // 先写临时文件再改名，中途失败不会留下半个缓存
+    static bool Write(const std::string& cachePath, const std::string& key, const std::vector<SectionData>& data) {
+        Header header;
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.sectionCount = static_cast<uint32_t>(data.size());
+        header.keyLength = static_cast<uint32_t>(key.size());
+
+        std::vector<SectionEntry> entries;
+        uint64_t offset = Align(sizeof(Header) + data.size() * sizeof(SectionEntry) + key.size());
+        for (const auto& d : data) {
+            entries.push_back({ d.id, d.elementSize, offset, d.count });
+            offset = Align(offset + d.count * d.elementSize);
+        }
+        header.fileSize = offset;
+
+        const std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SectionEntry));
+            out.write(key.data(), key.size());
+            for (size_t i = 0; i < data.size(); ++i) {
+                Pad(out, entries[i].offset);
+                out.write(static_cast<const char*>(data[i].data), data[i].count * data[i].elementSize);
             }
-            throw std::runtime_error("Unknown XDMF element type: " + std::to_string(type));
+            Pad(out, header.fileSize);
+            if (!out) return false;
         }
 
-        if (i + nodeCount >= rawData.size()) {
-            throw std::runtime_error("Topology data corrupted or incomplete.");
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
         }
+        return true;
+    }
 
-        MixedElement elem;
-        elem.type = type;
-        elem.conn.resize(nodeCount);
-        for (int j = 0; j < nodeCount; ++j) {
-            elem.conn[j] = static_cast<uint64_t>(rawData[i + 1 + j]);
-        }
-        mixedTopology.push_back(std::move(elem));
+private:
+    static constexpr char kMagic[8] = { 'X', 'M', 'C', 'A', 'C', 'H', 'E', '\0' };
+    static constexpr uint32_t kVersion = 10;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint32_t keyLength;
+        uint32_t reserved = 0;
+        uint64_t fileSize;
+    };
 
-        i += 1 + nodeCount;
-    }
-}
+    struct SectionEntry {
+        uint32_t id;
+        uint32_t elementSize;
+        uint64_t offset;
+        uint64_t count;
+    };
 
-int XdmfMeshLoader::GetNodeCountForXdmfType(uint8_t type) {
-    // 参考XDMF规范，常用单元类型及节点数
-    switch(type) {
-        case 1: return 2;  // (线)
-        case 2: return 3;  // 2(type), 2, xxx, xxx
-        case 4: return 3;  // (三角形)
+    std::shared_ptr<MappedFile> file;
+    std::vector<SectionEntry> sections;
+
+    bool Reject() {
+        file.reset();
+        sections.clear();
+        return false;
+    }
 
-        case 5: return 4;  // (四边形)
-        case 6: return 4;  // (四面体)
+    static uint64_t Align(uint64_t offset) {
+        return (offset + 15) & ~uint64_t(15);
+    }
 
-        case 7: return 5;  // (金字塔)
-        case 8: return 6;  // Prism (Wedge)
-        case 9: return 8;  // Hexahedron (6面体)
-        case 36: return 6; // 带有中点的三角形 2d
+    static void Pad(std::ofstream& out, uint64_t offset) {
+        static const char zeros[16] = {};
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        if (offset > pos) out.write(zeros, offset - pos);
+    }
 
-        default: return -1; // 未知类型
+    static std::string FileStamp(const std::string& path) {
+        std::ostringstream ss;
+        ss << "size=" << std::filesystem::file_size(path)
+           << ",mtime=" << std::filesystem::last_write_time(path).time_since_epoch().count() << ";";
+        return ss.str();
     }
-}
+};
+
 
 // 默认摄像机参数
 const float YAW         = -90.0f;
@@ -335,298 +2846,926 @@ public:
         glfwPollEvents();
     }
 
+    // 睡到有事件或过了 timeout 秒
+    void waitEvents(double timeout) {
+        glfwWaitEventsTimeout(timeout);
+    }
+
     void terminate() {
         glfwDestroyWindow(window);
         glfwTerminate();
     }
 };
 
-class Mesh {
+// ============ 流式缓冲区 ================
+
+// glad 可能只生成到 GL 3.3，4.x 的函数和常量自己补，函数指针用 glfwGetProcAddress 取
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+using BufferStorageProc = void (APIENTRY*)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// 当前上下文的版本至少是 major.minor，必须在持有 OpenGL 上下文的线程调用
+inline bool GlVersionAtLeast(int major, int minor) {
+    GLint contextMajor = 0, contextMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+inline bool GlHasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+// 每帧（或每次迭代）整段重写、GPU 只读的数据用的环形缓冲区：间接绘制命令、每帧 uniform、逐帧变化的场数据。
+// 缓冲区分成 kRegions 段轮流写，每段被 GPU 用完之前不会再写它，写入从不和 GPU 抢同一块内存。
+// 有 glBufferStorage（GL 4.4 或 ARB_buffer_storage）时整块持久、一致地映射，Begin 直接返回映射内存；
+// 轮到的段还没用完（GPU 落后了 kRegions 帧）时等它的 fence，正常帧率下 fence 早已完成，不会等。
+// 否则退回孤立（orphan）的写法：每次 glBufferData(nullptr) 换一块新存储再映射，驱动负责旧存储的生命周期。
+// 用法：Begin 得到可写指针 → 写满 bytes 字节 → End 得到这段的偏移 → 发出用到这段数据的 GL 命令；
+// 下一次 Begin 时给上一段插 fence，它覆盖了期间发出的所有命令。可以在后台线程构造，第一次 Begin 才创建缓冲区
+class StreamBuffer {
 public:
-    unsigned int VAO, VBO, EBO;
-    XdmfMeshLoader loader;
+    static constexpr int kRegions = 3;
+
+    // alignment：每段起点的对齐，例如 GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    StreamBuffer(GLenum target, size_t alignment = 4) : target(target), alignment(std::max<size_t>(alignment, 4)) {}
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // 返回至少 bytes 字节的可写内存，缓冲区绑定在 target 上；写完必须调用 End
+    void* Begin(size_t bytes) {
+        if (persistent && current >= 0) fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        if (buffer == 0 || bytes > regionBytes) Allocate(bytes);
+        glBindBuffer(target, buffer);
+
+        if (!persistent) {
+            current = 0;
+            glBufferData(target, regionBytes, nullptr, GL_STREAM_DRAW);
+            return glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
 
-    std::vector<float> vertices;                 // 每个顶点包含 6 个 float（位置 + 法线）
-    std::vector<unsigned int> triangle_indices;  // 三角面索引
-    std::vector<unsigned int> line_indices;      // 线索引
+        current = (current + 1) % kRegions;
+        if (GLsync fence = fences[current]) {
+            // 一般立即返回；GPU 真的落后时只能等，否则会改掉它还要读的数据
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fence);
+            fences[current] = nullptr;
+        }
+        return mapped + size_t(current) * regionBytes;
+    }
 
-    void mesh_face() {
-        std::unordered_map<uint64_t, int> indexMap;
-        std::vector<float> tempVertices;
-        std::vector<unsigned int> tempIndices;
+    // 返回刚写的这段在缓冲区里的字节偏移（glBindBufferRange、间接绘制的 indirect 参数等用）
+    size_t End() {
+        if (!persistent) {
+            glUnmapBuffer(target);
+            return 0;
+        }
+        return size_t(current) * regionBytes;
+    }
 
-        const auto& geom = loader.geometry;
-
-        for (const auto& elem : loader.mixedTopology) {
-            const auto& conn = elem.conn;
-
-            if (elem.type == 9 && conn.size() == 8) {  // HEX8
-                const int hexFaces[6][4] = {
-                    {0, 1, 2, 3}, {4, 5, 6, 7}, {0, 4, 5, 1},
-                    {3, 7, 6, 2}, {0, 3, 7, 4}, {1, 5, 6, 2}
-                };
-                for (const auto& face : hexFaces) {
-                    uint64_t a = conn[face[0]];
-                    uint64_t b = conn[face[1]];
-                    uint64_t c = conn[face[2]];
-                    uint64_t d = conn[face[3]];
-
-                    for (auto vid : {a, b, c, a, c, d}) {
-                        if (indexMap.count(vid) == 0) {
-                            indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                            tempVertices.insert(tempVertices.end(), {
-                                static_cast<float>(geom[vid][0]),
-                                static_cast<float>(geom[vid][1]),
-                                static_cast<float>(geom[vid][2])
-                            });
-                        }
-                        tempIndices.push_back(indexMap[vid]);
-                    }
-                }
-            } 
-            else if (elem.type == 8 && conn.size() == 6) {  // (三棱柱)
-                const int wedgeFaces[5][3] = {
-                    {0, 1, 2}, {3, 4, 5}, {0, 1, 4}, {1, 2, 5}, {2, 0, 3}
-                };
-                for (const auto& face : wedgeFaces) {
-                    uint64_t a = conn[face[0]];
-                    uint64_t b = conn[face[1]];
-                    uint64_t c = conn[face[2]];
-
-                    for (auto vid : {a, b, c}) {
-                        if (indexMap.count(vid) == 0) {
-                            indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                            tempVertices.insert(tempVertices.end(), {
-                                static_cast<float>(geom[vid][0]),
-                                static_cast<float>(geom[vid][1]),
-                                static_cast<float>(geom[vid][2])
-                            });
-                        }
-                        tempIndices.push_back(indexMap[vid]);
-                    }
-                }
-            } 
-            else if (elem.type == 7 && conn.size() == 5) {  // (金字塔单元)
-                // 底面四边形三角化为两个三角形
-                const int faces[6][3] = {
-                    {0, 1, 2}, {0, 2, 3}, // bottom (0-1-2-3)
-                    {0, 1, 4},            // side1
-                    {1, 2, 4},            // side2
-                    {2, 3, 4},            // side3
-                    {3, 0, 4}             // side4
-                };
-
-                for (const auto& face : faces) {
-                    for (int i = 0; i < 3; ++i) {
-                        uint64_t vid = conn[face[i]];
-                        if (indexMap.count(vid) == 0) {
-                            indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                            tempVertices.insert(tempVertices.end(), {
-                                static_cast<float>(geom[vid][0]),
-                                static_cast<float>(geom[vid][1]),
-                                static_cast<float>(geom[vid][2])
-                            });
-                        }
-                        tempIndices.push_back(indexMap[vid]);
-                    }
-                }
+    unsigned int Buffer() const { return buffer; }
+
+    // 驱动是否支持持久映射（否则每帧孤立重分配），界面上显示用
+    static bool PersistentSupported() { return BufferStorage() != nullptr; }
+
+    ~StreamBuffer() {
+        // 第一次 Begin 之后才有缓冲区，那时一定有上下文
+        if (buffer != 0) Release();
+    }
+
+private:
+    static BufferStorageProc BufferStorage() {
+        static const BufferStorageProc proc = [] {
+            BufferStorageProc loaded = nullptr;
+            if (GlVersionAtLeast(4, 4) || GlHasExtension("GL_ARB_buffer_storage")) {
+                loaded = reinterpret_cast<BufferStorageProc>(glfwGetProcAddress("glBufferStorage"));
             }
-            else if (elem.type == 6 && conn.size() == 4) {  // (四面体)
-                const int tetFaces[4][3] = {
-                    {0, 1, 2}, // bottom (顺时针)
-                    {3, 1, 0}, // side1
-                    {3, 2, 1}, // side2
-                    {3, 0, 2}  // side3
-                };
-                for (const auto& face : tetFaces) {
-                    for (int i = 0; i < 3; ++i) {
-                        uint64_t vid = conn[face[i]];
-                        if (indexMap.count(vid) == 0) {
-                            indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                            tempVertices.insert(tempVertices.end(), {
-                                static_cast<float>(geom[vid][0]),
-                                static_cast<float>(geom[vid][1]),
-                                static_cast<float>(geom[vid][2])
-                            });
-                        }
-                        tempIndices.push_back(indexMap[vid]);
-                    }
-                }
+            return loaded;
+        }();
+        return proc;
+    }
+
+    // 段大小按 2 的幂增长，换缓冲区时旧的直接删，GL 等 GPU 用完才真正释放
+    void Allocate(size_t bytes) {
+        if (buffer != 0) Release();
+        regionBytes = 256;
+        while (regionBytes < bytes) regionBytes *= 2;
+        regionBytes = (regionBytes + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        const BufferStorageProc bufferStorage = BufferStorage();
+        persistent = false;
+        if (bufferStorage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(target, regionBytes * kRegions, nullptr, flags);
+            mapped = static_cast<char*>(glMapBufferRange(target, 0, regionBytes * kRegions, flags));
+            persistent = mapped != nullptr;
+            if (!persistent) {
+                // 不可变存储不能再 glBufferData，换一个缓冲区走孤立的路径
+                glDeleteBuffers(1, &buffer);
+                glGenBuffers(1, &buffer);
+                glBindBuffer(target, buffer);
             }
-            else if (elem.type == 5 && conn.size() == 4) {  // 四边形面片
-                const int quadFaces[2][3] = {
-                    {0, 1, 2}, // 第一个三角形（顺时针）
-                    {0, 2, 3}  // 第二个三角形（顺时针）
-                };
-                for (const auto& face : quadFaces) {
-                    for (int i = 0; i < 3; ++i) {
-                        uint64_t vid = conn[face[i]];
-                        if (indexMap.count(vid) == 0) {
-                            indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                            tempVertices.insert(tempVertices.end(), {
-                                static_cast<float>(geom[vid][0]),
-                                static_cast<float>(geom[vid][1]),
-                                static_cast<float>(geom[vid][2])
-                            });
-                        }
-                        tempIndices.push_back(indexMap[vid]);
-                    }
-                }
+        }
+        current = -1;
+    }
+
+    void Release() {
+        for (GLsync& fence : fences) {
+            if (fence != nullptr) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        glDeleteBuffers(1, &buffer);  // 映射着的缓冲区删除时自动解除映射
+        buffer = 0;
+        mapped = nullptr;
+    }
+
+    GLenum target;
+    size_t alignment;
+    unsigned int buffer = 0;
+    size_t regionBytes = 0;
+    bool persistent = false;
+    char* mapped = nullptr;
+    int current = -1;  // 最近一次 Begin 的段
+    GLsync fences[kRegions] = {};
+};
+
+// ============ 绘制提交 ================
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+using MultiDrawElementsIndirectProc = void (APIENTRY*)(GLenum mode, GLenum type, const void* indirect,
+                                                       GLsizei drawCount, GLsizei stride);
+
+// glMultiDrawElementsIndirect 的一条命令，布局由 GL 规定
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// 把一帧里一个 Mesh 的所有可见段合成一次提交，CPU 开销不随块数增长。
+// GL 4.3 时命令写进间接绘制缓冲区，一次 glMultiDrawElementsIndirect；否则退回 glMultiDrawElementsBaseVertex（GL 3.2）。
+// 间接绘制时每条命令画 1 个实例，baseInstance 是调用方给的绘制槽号，除数为 1 的实例属性按它取每段自己的数据；
+// 退回的路径没有这个办法，需要逐段数据的着色器只能逐段画（见 Mesh::draw）。
+class DrawSubmitter {
+public:
+    DrawSubmitter() : commandStream(GL_DRAW_INDIRECT_BUFFER) {}
+    DrawSubmitter(const DrawSubmitter&) = delete;
+    DrawSubmitter& operator=(const DrawSubmitter&) = delete;
+
+    // 第一次调用时检测，必须在持有 OpenGL 上下文的线程调用
+    static bool IndirectSupported() { return MultiDrawIndirect() != nullptr; }
+
+    void Clear() { commands.clear(); }
+
+    // firstIndex 以索引个数计；slot 只在间接绘制时有意义
+    void Add(uint32_t indexCount, uint64_t firstIndex, uint32_t baseVertex, uint32_t slot) {
+        commands.push_back({ indexCount, 1, static_cast<uint32_t>(firstIndex), static_cast<int32_t>(baseVertex), slot });
+    }
+
+    // 用当前绑定的 VAO 画 16 位索引
+    void Submit(GLenum mode) {
+        if (commands.empty()) return;
+        const GLsizei drawCount = static_cast<GLsizei>(commands.size());
+        if (MultiDrawElementsIndirectProc multiDraw = MultiDrawIndirect()) {
+            const size_t bytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+            std::memcpy(commandStream.Begin(bytes), commands.data(), bytes);
+            const size_t offset = commandStream.End();
+            multiDraw(mode, GL_UNSIGNED_SHORT, reinterpret_cast<const void*>(offset), drawCount, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        counts.resize(commands.size());
+        offsets.resize(commands.size());
+        baseVertices.resize(commands.size());
+        for (size_t i = 0; i < commands.size(); ++i) {
+            counts[i] = static_cast<GLsizei>(commands[i].count);
+            offsets[i] = reinterpret_cast<const void*>(size_t(commands[i].firstIndex) * sizeof(uint16_t));
+            baseVertices[i] = commands[i].baseVertex;
+        }
+        glMultiDrawElementsBaseVertex(mode, counts.data(), GL_UNSIGNED_SHORT, offsets.data(), drawCount, baseVertices.data());
+    }
+
+private:
+    static MultiDrawElementsIndirectProc MultiDrawIndirect() {
+        static const MultiDrawElementsIndirectProc proc = [] {
+            MultiDrawElementsIndirectProc loaded = nullptr;
+            if (GlVersionAtLeast(4, 3)) {
+                loaded = reinterpret_cast<MultiDrawElementsIndirectProc>(glfwGetProcAddress("glMultiDrawElementsIndirect"));
             }
-            else if (elem.type == 4 && conn.size() == 3) {  // 三角形面片
-                const int triFace[3] = {0, 1, 2};  // 三角形顶点，顺时针
-                for (int i = 0; i < 3; ++i) {
-                    uint64_t vid = conn[triFace[i]];
-                    if (indexMap.count(vid) == 0) {
-                        indexMap[vid] = static_cast<int>(tempVertices.size() / 3);
-                        tempVertices.insert(tempVertices.end(), {
-                            static_cast<float>(geom[vid][0]),
-                            static_cast<float>(geom[vid][1]),
-                            static_cast<float>(geom[vid][2])
-                        });
-                    }
-                    tempIndices.push_back(indexMap[vid]);
+            return loaded;
+        }();
+        return proc;
+    }
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+    StreamBuffer commandStream;  // 间接绘制命令，每次 Submit 写一段
+};
+
+class Shader;
+
+// 面、线等多个绘制批次共用的一份顶点缓冲区，GPU 上只有一个 VBO。
+// 顶点按块存放（见 BuildVertexChunks），未量化时是 float xyz，量化时每个顶点 4 个 uint16；
+// chunks 给出每块的起始顶点、还原参数和包围盒，bvh 建在这些包围盒上用于视锥剔除。
+// 量化时还原参数另外上传成缓冲区纹理（块表），着色器按顶点里的块号取。
+class MeshGeometry {
+public:
+    unsigned int VBO = 0;
+    unsigned int chunkTableBuffer = 0, chunkTableTexture = 0;  // 每块 2 个 RGBA32F：offset、scale
+
+    std::vector<float> vertices;              // 自己持有的数据（提取结果），缓存映射时为空
+    std::vector<uint16_t> quantized_vertices;
+    std::vector<VertexChunk> chunks;
+    ChunkBvh bvh;
+
+    MeshGeometry() = default;
+    MeshGeometry(const MeshGeometry&) = delete;
+    MeshGeometry& operator=(const MeshGeometry&) = delete;
+
+    // data 指向 vertices 或 keepAlive 持有的外部内存（例如缓存文件），upload() 之前不复制
+    void SetVertices(const float* data, size_t vertexCount, std::vector<VertexChunk> chunkList,
+                     std::shared_ptr<const void> keepAlive = nullptr) {
+        quantized = false;
+        pendingData = data;
+        pendingBytes = vertexCount * 3 * sizeof(float);
+        pendingOwner = std::move(keepAlive);
+        chunks = std::move(chunkList);
+        bvh.Build(chunks);
+    }
+
+    void SetQuantizedVertices(const uint16_t* data, size_t vertexCount, std::vector<VertexChunk> chunkList,
+                              std::shared_ptr<const void> keepAlive = nullptr) {
+        quantized = true;
+        pendingData = data;
+        pendingBytes = vertexCount * 4 * sizeof(uint16_t);
+        pendingOwner = std::move(keepAlive);
+        chunks = std::move(chunkList);
+        bvh.Build(chunks);
+    }
+
+    bool Quantized() const { return quantized; }
+
+    // 上传 VBO，必须在持有 OpenGL 上下文的线程调用；多个 Mesh 共用时只上传一次
+    void upload() {
+        if (VBO != 0) return;
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, pendingBytes, pendingData, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (quantized) {
+            std::vector<float> table(chunks.size() * 8, 0.0f);
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                for (int k = 0; k < 3; ++k) {
+                    table[c * 8 + k] = chunks[c].offset[k];
+                    table[c * 8 + 4 + k] = chunks[c].scale[k];
                 }
             }
+            glGenBuffers(1, &chunkTableBuffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, chunkTableBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(float), table.data(), GL_STATIC_DRAW);
+            glGenTextures(1, &chunkTableTexture);
+            glBindTexture(GL_TEXTURE_BUFFER, chunkTableTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, chunkTableBuffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+        pendingOwner.reset();
+        std::vector<float>().swap(vertices);
+        std::vector<uint16_t>().swap(quantized_vertices);
+    }
+
+    // 在当前绑定的 VAO 上设置位置属性；量化坐标不归一化，着色器里拿到的是 0..65535，w 是块号
+    void bindAttributes() const {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (quantized) glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_FALSE, 4 * sizeof(uint16_t), (void*)0);
+        else           glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+
+    // 设置着色器的 uQuantized，量化时把块表绑到 unit（着色器的 uChunkTable 要指向同一个纹理单元）
+    void bindChunkTable(const Shader& shader, int unit) const;
+
+    ~MeshGeometry() {
+        // 没上传过就不调用 GL，析构可能发生在没有上下文的线程
+        if (VBO != 0) glDeleteBuffers(1, &VBO);
+        if (chunkTableTexture != 0) {
+            glDeleteTextures(1, &chunkTableTexture);
+            glDeleteBuffers(1, &chunkTableBuffer);
+        }
+    }
+
+private:
+    bool quantized = false;
+    const void* pendingData = nullptr;
+    size_t pendingBytes = 0;
+    std::shared_ptr<const void> pendingOwner;
+};
+
+// 一个索引缓冲区 + 图元类型，顶点来自共享的 MeshGeometry。
+// 索引是 16 位块内编号，每个 DrawRange 是多重绘制里的一条。
+class Mesh {
+public:
+    unsigned int VAO = 0, EBO = 0;
+    unsigned int edgeMaskBuffer = 0, edgeMaskTexture = 0;  // edge_masks 的缓冲区纹理
+    // 着色器里 aPrimitiveBase 的位置，GLSL 中用 layout(location = 1) 固定；VAO 的实例属性按它设置
+    static constexpr GLuint kPrimitiveBaseAttribute = 1;
+    // 间接绘制时每个绘制槽（先是各段，后是各简化级别）第一个三角形的编号，实例属性按 baseInstance 取
+    unsigned int drawSlotBuffer = 0;
+    GLenum mode = GL_TRIANGLES;
+    std::shared_ptr<MeshGeometry> geometry;
+
+    std::vector<uint16_t> indices;  // 块内编号
+    std::vector<DrawRange> ranges;
+    // 表面三角形按索引缓冲区中的顺序，每个一个字节：第 k 位表示第 k 个角对面的边是多边形的边，
+    // 四边形拆出来的对角线该位为 0。单遍线框着色器据此不画对角线
+    std::vector<uint8_t> edge_masks;
+    // 表面各段预先简化出的各级（见 LodLevel），按段分组、组内从细到粗；线框没有
+    std::vector<LodLevel> lods;
+
+    Mesh(std::shared_ptr<MeshGeometry> geometry, GLenum mode) : mode(mode), geometry(std::move(geometry)) {}
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // data 指向 indices 或 keepAlive 持有的外部内存，upload() 之前不复制
+    void SetIndices(const uint16_t* data, size_t count, std::vector<DrawRange> rangeList,
+                    std::shared_ptr<const void> keepAlive = nullptr) {
+        pendingData = data;
+        pendingBytes = count * sizeof(uint16_t);
+        pendingOwner = std::move(keepAlive);
+        ranges = std::move(rangeList);
+    }
+
+    void SetEdgeMasks(const uint8_t* data, size_t count, std::shared_ptr<const void> keepAlive = nullptr) {
+        pendingMasks = data;
+        pendingMaskCount = count;
+        pendingMaskOwner = std::move(keepAlive);
+    }
+
+    // 上传过逐三角形的边标记，可以用单遍线框着色器绘制
+    bool HasEdgeMasks() const { return edgeMaskTexture != 0; }
+
+    // 必须在 SetIndices 之后调用
+    void SetLods(std::vector<LodLevel> levels) {
+        lods = std::move(levels);
+        lodBegin.assign(ranges.size() + 1, 0);
+        for (const LodLevel& lod : lods) ++lodBegin[lod.range + 1];
+        for (size_t r = 0; r < ranges.size(); ++r) lodBegin[r + 1] += lodBegin[r];
+    }
+
+    bool HasLods() const { return !lods.empty(); }
+
+    // 每段选误差投影到屏幕上不超过 pixelError 像素的最粗一级，lodChoice[段] 为 lods 的下标，-1 表示原始三角形。
+    // 一个长度 e 在裁剪坐标 w 处约占 e·|MVP 第二行|·viewportHeight / (2w) 个像素，w 取包围盒上的最小值
+    void SelectLods(const glm::mat4& mvp, int viewportHeight, float pixelError, std::vector<int32_t>& lodChoice) const {
+        lodChoice.assign(ranges.size(), -1);
+        const float pixelsPerUnit = glm::length(glm::vec3(mvp[0][1], mvp[1][1], mvp[2][1])) * 0.5f * viewportHeight;
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            if (lodBegin[r] == lodBegin[r + 1]) continue;
+            const VertexChunk& chunk = geometry->chunks[ranges[r].chunk];
+            float w = mvp[3][3];
+            for (int c = 0; c < 3; ++c) w += std::min(mvp[c][3] * chunk.boundsMin[c], mvp[c][3] * chunk.boundsMax[c]);
+            if (w <= 0.0f) continue;  // 包围盒跨过相机平面，用原始三角形
+            for (uint32_t i = lodBegin[r]; i < lodBegin[r + 1] && lods[i].error * pixelsPerUnit <= pixelError * w; ++i) {
+                lodChoice[r] = static_cast<int32_t>(i);
+            }
+        }
+    }
+
+    // draw 用同样的参数时实际画出的三角形数
+    size_t TriangleCount(const std::vector<uint8_t>* visibleChunks, const std::vector<int32_t>* lodChoice) const {
+        size_t count = 0;
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            if (visibleChunks && !(*visibleChunks)[ranges[r].chunk]) continue;
+            const int32_t lod = lodChoice ? (*lodChoice)[r] : -1;
+            count += (lod >= 0 ? lods[lod].indexCount : ranges[r].indexCount) / 3;
         }
+        return count;
+    }
 
-        vertices = std::move(tempVertices);
-        triangle_indices = std::move(tempIndices);
+    // 把构造时准备好的数据上传到 GPU（共享的顶点缓冲区也一起），必须在持有 OpenGL 上下文的线程调用
+    void upload() {
+        if (VAO != 0) return;
+        geometry->upload();
 
-        // OpenGL: setup VAO / VBO / EBO
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
-
         glBindVertexArray(VAO);
+        geometry->bindAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, pendingBytes, pendingData, GL_STATIC_DRAW);
+        if (DrawSubmitter::IndirectSupported()) {
+            std::vector<uint32_t> primitiveBase;
+            primitiveBase.reserve(ranges.size() + lods.size());
+            for (const DrawRange& range : ranges) primitiveBase.push_back(static_cast<uint32_t>(range.firstIndex / 3));
+            for (const LodLevel& lod : lods) primitiveBase.push_back(static_cast<uint32_t>(lod.firstIndex / 3));
+            glGenBuffers(1, &drawSlotBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, drawSlotBuffer);
+            glBufferData(GL_ARRAY_BUFFER, primitiveBase.size() * sizeof(uint32_t), primitiveBase.data(), GL_STATIC_DRAW);
+            glVertexAttribIPointer(kPrimitiveBaseAttribute, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+            glVertexAttribDivisor(kPrimitiveBaseAttribute, 1);
+            glEnableVertexAttribArray(kPrimitiveBaseAttribute);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (pendingMaskCount > 0) {
+            // 缓冲区纹理的大小上限由驱动决定（规范只保证 64K 个），超出时退回两遍绘制
+            GLint maxTexels = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+            if (pendingMaskCount <= static_cast<size_t>(maxTexels)) {
+                glGenBuffers(1, &edgeMaskBuffer);
+                glBindBuffer(GL_TEXTURE_BUFFER, edgeMaskBuffer);
+                glBufferData(GL_TEXTURE_BUFFER, pendingMaskCount, pendingMasks, GL_STATIC_DRAW);
+                glGenTextures(1, &edgeMaskTexture);
+                glBindTexture(GL_TEXTURE_BUFFER, edgeMaskTexture);
+                glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, edgeMaskBuffer);
+                glBindTexture(GL_TEXTURE_BUFFER, 0);
+                glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            } else {
+                std::cerr << "Edge mask buffer too large (" << pendingMaskCount << " > " << maxTexels
+                          << "), single-pass wireframe disabled" << std::endl;
+            }
+        }
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        pendingOwner.reset();
+        pendingMaskOwner.reset();
+        std::vector<uint16_t>().swap(indices);
+        std::vector<uint8_t>().swap(edge_masks);
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangle_indices.size() * sizeof(unsigned int), triangle_indices.data(), GL_STATIC_DRAW);
+    // 所有要画的段合成一次多重绘制（见 DrawSubmitter）。着色器的 aPrimitiveBase 是该段第一个三角形的编号
+    // （gl_PrimitiveID 每条绘制从 0 开始）：间接绘制时来自 drawSlotBuffer，否则逐段设成常量属性、逐段画。
+    // visibleChunks 非空时跳过不可见块的段（见 ChunkBvh::Cull），lodChoice 非空时按它换成简化后的某一级（见 SelectLods）
+    void draw(const Shader& shader, const std::vector<uint8_t>* visibleChunks = nullptr,
+              const std::vector<int32_t>* lodChoice = nullptr) const;
 
-        // vertex position attribute only
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    ~Mesh() {
+        // 没上传过（例如后台加载被取消）就不调用 GL，析构可能发生在没有上下文的线程
+        if (VAO == 0) return;
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &EBO);
+        if (edgeMaskTexture != 0) {
+            glDeleteTextures(1, &edgeMaskTexture);
+            glDeleteBuffers(1, &edgeMaskBuffer);
+        }
+        if (drawSlotBuffer != 0) glDeleteBuffers(1, &drawSlotBuffer);
+    }
 
-        glBindVertexArray(0);
+private:
+    std::vector<uint32_t> lodBegin;  // 第 r 段的各级是 lods[lodBegin[r], lodBegin[r + 1])
+    mutable DrawSubmitter submitter;  // 每帧重填的命令缓冲，不算网格本身的状态
+    const void* pendingData = nullptr;
+    size_t pendingBytes = 0;
+    std::shared_ptr<const void> pendingOwner;
+    const uint8_t* pendingMasks = nullptr;
+    size_t pendingMaskCount = 0;
+    std::shared_ptr<const void> pendingMaskOwner;
+};
+
+// 从 loader 提取渲染用的面 / 线，只在 CPU 上，不碰 OpenGL，可以在后台线程运行；之后在渲染线程调用 upload()。
+// 两者共用一个顶点缓冲区：只含被引用的节点，表面三角形先用到的在前，线框额外需要的（内部节点）在后。
+// loader 只被引用，不复制；progress 非空时按已处理的单元数更新进度，用户取消时抛 LoadCancelled。
+class RenderMeshBuilder {
+public:
+    RenderMeshBuilder(const XdmfMeshLoader& loader, const MeshBuildOptions& options, LoadProgress* progress = nullptr)
+        : loader(loader), options(options), progress(progress) {}
+
+    void Build(std::unique_ptr<Mesh>& face, std::unique_ptr<Mesh>& line) {
+        std::cout << "Loaded geometry points count: " << loader.PointCount() << std::endl;
+        std::cout << "Loaded topology elements count: " << loader.topology.size() << std::endl;
+
+        std::vector<unsigned int> lineIndices, faceIndices;  // 先是全局节点号，重排后是共享顶点号
+        std::vector<uint8_t> edgeMasks;
+        std::vector<uint32_t> regions;
+        std::vector<uint32_t> clusterStarts;
+        // 面配对只做一遍，表面和边界边模式的线框共用
+        FaceMatcher matcher;
+        if (options.buildFaces || (options.buildLines && options.edgeMode != EdgeMode::All)) {
+            if (progress) progress->Begin(LoadStage::MatchFaces);
+            matcher.Match(loader.topology, loader.PointCount(), progress);
+            if (matcher.nonManifoldFaces > 0) {
+                std::cerr << "Warning: " << matcher.nonManifoldFaces << " non-manifold faces (shared by 3+ cells)";
+                for (const auto& [e, f] : matcher.nonManifoldSamples) std::cerr << " [element " << e << " face " << f << "]";
+                std::cerr << std::endl;
+            }
+        }
+        if (progress) progress->Begin(LoadStage::ExtractEdges);
+        if (options.buildLines) lineIndices = ExtractEdges(matcher);
+        if (progress) progress->Begin(LoadStage::ExtractFaces);
+        if (options.buildFaces) faceIndices = ExtractSurface(matcher, edgeMasks, regions, clusterStarts);
+
+        // 共享顶点：按 面、线 的顺序首次使用重排，没被引用的节点不上传
+        const std::vector<unsigned int> order = OptimizeVertexFetch(loader.PointCount(), { &faceIndices, &lineIndices });
+        std::vector<float> vertices(order.size() * 3);
+        loader.VisitGeometry([&](const auto& geom) {
+            ParallelFor(order.size(), [&](size_t begin, size_t end) {
+                for (size_t v = begin; v < end; ++v) {
+                    for (int c = 0; c < 3; ++c) vertices[v * 3 + c] = static_cast<float>(geom[order[v]][c]);
+                }
+            });
+        });
+        std::cout << "Shared render vertices: " << order.size() << " of " << loader.PointCount() << " points" << std::endl;
+
+        // 每个空间簇单独成块，线框的边尽量落进已有的块
+        std::vector<ChunkPass> passes(2);
+        passes[0].indices = &faceIndices;
+        passes[0].primitiveSize = 3;
+        passes[0].segments = &clusterStarts;
+        passes[1].indices = &lineIndices;
+        passes[1].primitiveSize = 2;
+        ChunkedGeometry chunked = BuildVertexChunks(vertices, passes, options.quantizePositions);
+        std::vector<float>().swap(vertices);
+        std::cout << "Render chunks: " << chunked.chunks.size() << " (" << clusterStarts.size() << " surface clusters, "
+                  << (chunked.vertices.size() / 3 + chunked.quantizedVertices.size() / 4) << " vertices after splitting"
+                  << (chunked.quantized ? ", quantized" : "") << ")" << std::endl;
+
+        // 边标记、材料号跟着分块后的三角形顺序走
+        const std::vector<uint32_t>& primitiveOrder = passes[0].outPrimitiveOrder;
+        std::vector<uint8_t> masks(edgeMasks.size());
+        for (size_t t = 0; t < masks.size(); ++t) masks[t] = edgeMasks[primitiveOrder[t]];
+        if (!regions.empty()) {
+            std::vector<uint32_t> reordered(regions.size());
+            for (size_t t = 0; t < reordered.size(); ++t) reordered[t] = regions[primitiveOrder[t]];
+            regions.swap(reordered);
+        }
+
+        std::vector<LodLevel> lods;
+        if (options.lodLevels > 0 && !passes[0].outRanges.empty()) {
+            if (progress) progress->Begin(LoadStage::Simplify);
+            lods = AppendSurfaceLods(chunked, passes[0], masks, regions);
+        }
+
+        auto geometry = std::make_shared<MeshGeometry>();
+        if (chunked.quantized) {
+            geometry->quantized_vertices = std::move(chunked.quantizedVertices);
+            geometry->SetQuantizedVertices(geometry->quantized_vertices.data(), geometry->quantized_vertices.size() / 4,
+                                           std::move(chunked.chunks));
+        } else {
+            geometry->vertices = std::move(chunked.vertices);
+            geometry->SetVertices(geometry->vertices.data(), geometry->vertices.size() / 3, std::move(chunked.chunks));
+        }
+
+        face = std::make_unique<Mesh>(geometry, GL_TRIANGLES);
+        line = std::make_unique<Mesh>(geometry, GL_LINES);
+        Mesh* meshes[2] = { face.get(), line.get() };
+        for (int i = 0; i < 2; ++i) {
+            meshes[i]->indices = std::move(passes[i].outIndices);
+            meshes[i]->SetIndices(meshes[i]->indices.data(), meshes[i]->indices.size(), std::move(passes[i].outRanges));
+        }
+        face->edge_masks = std::move(masks);
+        face->SetEdgeMasks(face->edge_masks.data(), face->edge_masks.size());
+        face->SetLods(std::move(lods));
     }
 
-    void mesh_line() {
-
-        std::cout << "Loaded geometry points count: " << loader.geometry.size() << std::endl;
-        std::cout << "Loaded mixed topology elements count: " << loader.mixedTopology.size() << std::endl;
+private:
+    static constexpr size_t kClusterTriangles = 4096;  // 每个空间簇（剔除的最小单位）最多的三角形数
+    static constexpr size_t kSimplifyBatch = 64;       // 每批并行简化的块数，批之间报告进度
+
+    // 每个表面块（绘制段）预先简化出若干级，索引和边标记接在原始三角形后面。
+    // 简化后的三角形只标记原来就是多边形边的那些边，单遍线框画的是真实网格边的子集
+    std::vector<LodLevel> AppendSurfaceLods(const ChunkedGeometry& chunked, ChunkPass& pass, std::vector<uint8_t>& masks,
+                                            const std::vector<uint32_t>& regions) {
+        const std::vector<DrawRange>& ranges = pass.outRanges;
+        std::vector<std::vector<SimplifiedLevel>> results(ranges.size());
+        for (size_t first = 0; first < ranges.size(); first += kSimplifyBatch) {
+            const size_t count = std::min(kSimplifyBatch, ranges.size() - first);
+            ParallelFor(count, [&](size_t begin, size_t end) {
+                std::vector<float> positions;
+                for (size_t i = first + begin; i < first + end; ++i) {
+                    const DrawRange& range = ranges[i];
+                    const VertexChunk& chunk = chunked.chunks[range.chunk];
+                    positions.resize(size_t(chunk.vertexCount) * 3);
+                    for (uint32_t v = 0; v < chunk.vertexCount; ++v) {
+                        const size_t src = size_t(chunk.baseVertex) + v;
+                        for (int c = 0; c < 3; ++c) {
+                            positions[size_t(v) * 3 + c] = chunked.quantized
+                                ? chunk.offset[c] + chunked.quantizedVertices[src * 4 + c] * chunk.scale[c]
+                                : chunked.vertices[src * 3 + c];
+                        }
+                    }
+                    results[i] = SimplifyChunk(positions, &pass.outIndices[range.firstIndex], range.indexCount / 3,
+                                               regions.empty() ? nullptr : &regions[range.firstIndex / 3], options.lodLevels);
+                }
+            }, 1);
+            if (progress) progress->Update(static_cast<float>(first + count) / static_cast<float>(ranges.size()));
+        }
 
-        // === 顶点数据 ===
-        for (const auto& pt : loader.geometry) {
-            vertices.push_back(static_cast<float>(pt[0]));
-            vertices.push_back(static_cast<float>(pt[1]));
-            vertices.push_back(static_cast<float>(pt[2]));
+        std::vector<LodLevel> lods;
+        const size_t baseTriangles = pass.outIndices.size() / 3;
+        std::vector<uint32_t> polygonEdges;  // 块内编号 (较小 << 16 | 较大)
+        auto edgeKey = [](uint32_t a, uint32_t b) { return std::min(a, b) << 16 | std::max(a, b); };
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (results[i].empty()) continue;
+            const DrawRange range = ranges[i];
+            polygonEdges.clear();
+            for (uint64_t t = range.firstIndex / 3; t < (range.firstIndex + range.indexCount) / 3; ++t) {
+                const uint16_t* tri = &pass.outIndices[t * 3];
+                for (int k = 0; k < 3; ++k) {
+                    if (masks[t] >> k & 1) polygonEdges.push_back(edgeKey(tri[(k + 1) % 3], tri[(k + 2) % 3]));
+                }
+            }
+            std::sort(polygonEdges.begin(), polygonEdges.end());
+
+            for (const SimplifiedLevel& level : results[i]) {
+                LodLevel lod;
+                lod.firstIndex = pass.outIndices.size();
+                lod.indexCount = static_cast<uint32_t>(level.indices.size());
+                lod.chunk = range.chunk;
+                lod.error = level.error;
+                lod.range = static_cast<uint32_t>(i);
+                for (size_t t = 0; t < level.indices.size(); t += 3) {
+                    uint8_t mask = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        const uint32_t key = edgeKey(level.indices[t + (k + 1) % 3], level.indices[t + (k + 2) % 3]);
+                        if (std::binary_search(polygonEdges.begin(), polygonEdges.end(), key)) mask |= 1 << k;
+                    }
+                    masks.push_back(mask);
+                }
+                pass.outIndices.insert(pass.outIndices.end(), level.indices.begin(), level.indices.end());
+                lods.push_back(lod);
+            }
         }
+        std::cout << "Surface LOD: " << lods.size() << " levels over " << ranges.size() << " chunks, "
+                  << baseTriangles << " triangles + " << (pass.outIndices.size() / 3 - baseTriangles) << " simplified" << std::endl;
+        return lods;
+    }
 
-        // === 拓扑线框处理 ===
-        for (const auto& elem : loader.mixedTopology) {
-            const auto& conn = elem.conn;
-            if (elem.type == 9 && conn.size() == 8) {
-                // HEX8: 六面体立方体
-                AddEdges(line_indices, conn, {
-                    {0,1}, {1,2}, {2,3}, {3,0}, // bottom
-                    {4,5}, {5,6}, {6,7}, {7,4}, // top
-                    {0,4}, {1,5}, {2,6}, {3,7}  // sides
+    const XdmfMeshLoader& loader;
+    MeshBuildOptions options;
+    LoadProgress* progress = nullptr;
+    size_t elementsProcessed = 0;
+    size_t progressTotal = 1;  // 本阶段要遍历的单元总数（多遍时累加）
+
+    // 只输出边界面：matcher（已经 Match 过）统计每个体单元面被几个单元共享，只出现一次的面才在表面上，
+    // 两个单元共享的内部面被剔除。二维单元（三角形、四边形）本身就是表面，直接输出。
+    // 返回三角形的全局节点号，edgeMasks 为每个三角形的边标记（见 Mesh::edge_masks），
+    // 三角形按空间簇排列，clusterStarts 为每簇的第一个三角形
+    std::vector<unsigned int> ExtractSurface(const FaceMatcher& matcher, std::vector<uint8_t>& edgeMasks,
+                                             std::vector<uint32_t>& regions, std::vector<uint32_t>& clusterStarts) {
+        // 全局节点号 -> 表面顶点号，稠密数组代替哈希表，一次访问就能判断是否已输出
+        constexpr unsigned int kUnmapped = std::numeric_limits<unsigned int>::max();
+        std::vector<unsigned int> remap(loader.PointCount(), kUnmapped);
+        std::vector<unsigned int> surfaceNodes;  // 表面顶点号 -> 全局节点号
+        std::vector<float> tempVertices;
+        std::vector<unsigned int> tempIndices;
+
+        const size_t numElements = loader.topology.size();
+        progressTotal = numElements;
+        elementsProcessed = 0;
+
+        // 要做简化时记下每个三角形所属单元的材料号，没有这个属性就都当成同一种材料
+        std::vector<uint32_t> elementRegions;
+        if (options.lodLevels > 0 && !options.materialAttribute.empty()) {
+            auto it = loader.cellAttributes.find(options.materialAttribute);
+            if (it != loader.cellAttributes.end() && it->second.size() == numElements) {
+                it->second.Visit([&](const auto& values) {
+                    elementRegions.resize(values.size());
+                    for (size_t e = 0; e < values.size(); ++e) elementRegions[e] = static_cast<uint32_t>(values[e]);
                 });
+                it->second.Unload();
             }
-            else if (elem.type == 8 && conn.size() == 6) {  // (三棱柱)
-                // WEDGE6: 三棱柱
-                AddEdges(line_indices, conn, {
-                    {0,1}, {1,2}, {2,0},       // bottom triangle
-                    {3,4}, {4,5}, {5,3},       // top triangle
-                    {0,3}, {1,4}, {2,5}        // vertical edges
-                });
-            } 
-            else if (elem.type == 7 && conn.size() == 5) {  // (金字塔)
-                AddEdges(line_indices, conn, {
-                    {0,1}, {1,2}, {2,3}, {3,0}, // 底面边
-                    {0,4}, {1,4}, {2,4}, {3,4}  // 侧面边
-                });
-            } 
-            else if (elem.type == 6 && conn.size() == 4) {  // (四面体)
-                AddEdges(line_indices, conn, {
-                    {0,1}, {1,2}, {2,0},  // 底面三角形
-                    {0,3}, {1,3}, {2,3}   // 连接顶点 3 的三条边
-                });
-            } 
-            else if (elem.type == 5 && conn.size() == 4) {  // (四边形)
-                AddEdges(line_indices, conn, {
-                    {0,1}, {1,2}, {2,3}, {3,0}
-                });
-            } 
-            else if (elem.type == 4 && conn.size() == 3) {  // (三角形)
-                AddEdges(line_indices, conn, {
-                    {0, 1}, {1, 2}, {2, 0}
+        }
+
+        // 按单元顺序输出边界面，结果可重复。全部来自体单元时表面封闭、绕向朝外
+        bool volumeSurface = true;
+        // 单精度模式下坐标已经是 float，下面的 static_cast 不产生任何转换
+        loader.VisitGeometry([&](const auto& geom) {
+            auto emit = [&](uint64_t vid) {
+                unsigned int& slot = remap[vid];
+                if (slot == kUnmapped) {
+                    slot = static_cast<unsigned int>(surfaceNodes.size());
+                    surfaceNodes.push_back(static_cast<unsigned int>(vid));
+                    tempVertices.insert(tempVertices.end(), {
+                        static_cast<float>(geom[vid][0]),
+                        static_cast<float>(geom[vid][1]),
+                        static_cast<float>(geom[vid][2])
+                    });
+                }
+                tempIndices.push_back(slot);
+            };
+
+            // 三角形原样输出，四边形按 (0,1,2) (0,2,3) 拆成两个三角形，
+            // 对角线 0-2 分别是第一个三角形 1 号角、第二个三角形 2 号角的对边
+            auto emitFace = [&](const uint64_t* nodes, int count, uint32_t region) {
+                for (int i = 0; i < 3; ++i) emit(nodes[i]);
+                if (count == 4) {
+                    emit(nodes[0]);
+                    emit(nodes[2]);
+                    emit(nodes[3]);
+                    edgeMasks.push_back(0b101);
+                    edgeMasks.push_back(0b011);
+                } else {
+                    edgeMasks.push_back(0b111);
+                }
+                if (!elementRegions.empty()) regions.insert(regions.end(), count == 4 ? 2 : 1, region);
+            };
+
+            loader.topology.ForEachByTypeInRange(0, numElements, [&](auto type, const auto& conn, size_t e) {
+                ReportProgress();
+                if constexpr (ElementTraitsFor(type)->dimension == 2) volumeSurface = false;
+                const uint32_t region = elementRegions.empty() ? 0 : elementRegions[e];
+                ForEachSurfaceFace<type>(matcher, conn, e, [&](uint64_t, const uint64_t* nodes, int count) {
+                    emitFace(nodes, count, region);
                 });
-            } else {
-                // std::cerr << "Skipping unsupported element type: " << static_cast<int>(elem.type) << " with " << conn.size() << " nodes\n";
+            });
+        });
+
+        // 三角形重排时边标记和材料号跟着走；order 为 新三角形号 -> 原三角形号
+        auto reorderMasks = [&](const std::vector<uint32_t>& order) {
+            std::vector<uint8_t> reordered(order.size());
+            for (size_t t = 0; t < order.size(); ++t) reordered[t] = edgeMasks[order[t]];
+            edgeMasks.swap(reordered);
+            if (regions.empty()) return;
+            std::vector<uint32_t> reorderedRegions(order.size());
+            for (size_t t = 0; t < order.size(); ++t) reorderedRegions[t] = regions[order[t]];
+            regions.swap(reorderedRegions);
+        };
+
+        VertexCacheStats before;
+        if (options.diagnostics) before = AnalyzeVertexCache(tempIndices, surfaceNodes.size());
+        if (options.optimizeVertexCache) reorderMasks(OptimizeVertexCache(tempIndices, surfaceNodes.size()));
+
+        // 按空间聚簇，簇内保持 Tipsify 的顺序
+        const std::vector<uint32_t> clusterOrder = ClusterTriangles(tempVertices, tempIndices, kClusterTriangles, clusterStarts);
+        {
+            std::vector<unsigned int> clustered(tempIndices.size());
+            for (size_t t = 0; t < clusterOrder.size(); ++t) {
+                for (int k = 0; k < 3; ++k) clustered[t * 3 + k] = tempIndices[size_t(clusterOrder[t]) * 3 + k];
             }
+            tempIndices.swap(clustered);
+            reorderMasks(clusterOrder);
         }
 
-        // === OpenGL Buffer ===
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        if (options.diagnostics) {
+            const VertexCacheStats after = AnalyzeVertexCache(tempIndices, surfaceNodes.size());
+            std::cout << "Surface vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+                      << ", ATVR " << before.atvr << " -> " << after.atvr
+                      << ", overdraw " << AnalyzeOverdraw(tempVertices, tempIndices, volumeSurface) << std::endl;
+        }
 
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, line_indices.size() * sizeof(unsigned int), line_indices.data(), GL_STATIC_DRAW);
+        for (unsigned int& v : tempIndices) v = surfaceNodes[v];
+        return tempIndices;
+    }
 
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
+    // 返回线段的全局节点号，每条边只输出一次，按 (较小节点, 较大节点) 排序。
+    // EdgeMode::All 以外 matcher 必须已经 Match 过
+    std::vector<unsigned int> ExtractEdges(const FaceMatcher& matcher) {
+        const CellTopology& topology = loader.topology;
+        const size_t numElements = topology.size();
+        const uint64_t numPoints = loader.PointCount();
+        std::vector<unsigned int> lineIndices;
+        auto addEdge = [&](uint64_t a, uint64_t b) {
+            lineIndices.push_back(static_cast<unsigned int>(a));
+            lineIndices.push_back(static_cast<unsigned int>(b));
+        };
+        if (options.edgeMode == EdgeMode::All) {
+            EdgeGrouper<uint64_t> edges;
+            edges.Build(numElements, numPoints, [&](size_t begin, size_t end, auto&& emit) {
+                topology.ForEachByTypeInRange(begin, end, [&](auto type, const auto& conn, size_t) {
+                    constexpr const CellEdgeTable& table = ElementTraitsFor(type)->edges;
+                    for (int k = 0; k < table.edgeCount; ++k) emit(conn[table.edges[k][0]], conn[table.edges[k][1]], 0);
+                });
+            });
+            if (progress) progress->Update(0.5f);
+            lineIndices.reserve(edges.occurrences() / 2);
+            edges.ForEachEdge([&](uint64_t a, uint64_t b, const uint64_t*, size_t) { addEdge(a, b); });
+        } else {
+            // 表面多边形：体单元的边界面 + 二维单元本身，faceId = e * 6 + 局部面号
+            EdgeGrouper<TaggedEdge> edges;
+            edges.Build(numElements, numPoints, [&](size_t begin, size_t end, auto&& emit) {
+                topology.ForEachByTypeInRange(begin, end, [&](auto type, const auto& conn, size_t e) {
+                    ForEachSurfaceFace<type>(matcher, conn, e, [&](uint64_t faceId, const uint64_t* nodes, int count) {
+                        for (int k = 0; k < count; ++k) emit(nodes[k], nodes[(k + 1) % count], faceId);
+                    });
+                });
+            });
+            if (progress) progress->Update(0.5f);
 
-        glBindVertexArray(0);
-    }
+            if (options.creaseAngle <= 0.0f) {
+                edges.ForEachEdge([&](uint64_t a, uint64_t b, const TaggedEdge*, size_t) { addEdge(a, b); });
+            } else {
+                const double cosThreshold = std::cos(options.creaseAngle * 3.14159265358979323846 / 180.0);
+                loader.VisitGeometry([&](const auto& geom) {
+                    // 多边形法向（Newell 方法，四边形不共面时也稳定）。体单元的面再按 (面中心 - 单元中心) 翻成朝外，
+                    // 不依赖面表和单元自身的节点顺序；二维单元没有内外之分，oriented 为 false
+                    struct FaceNormal {
+                        std::array<double, 3> n;
+                        bool oriented;
+                    };
+                    auto faceNormal = [&](uint64_t faceId) {
+                        uint64_t nodes[4];
+                        int count = 0;
+                        bool volume = false;
+                        std::array<double, 3> cellCenter = { 0.0, 0.0, 0.0 };
+                        topology.VisitElement(faceId / FaceMatcher::kMaxFacesPerCell, [&](const auto& elem) {
+                            const ElementTraits& traits = *ElementTraitsFor(elem.type);
+                            const CellFaceTable& table = traits.faces;
+                            const int f = static_cast<int>(faceId % FaceMatcher::kMaxFacesPerCell);
+                            count = table.faces[f][3] < 0 ? 3 : 4;
+                            for (int k = 0; k < count; ++k) nodes[k] = elem[table.faces[f][k]];
+                            volume = traits.dimension == 3;
+                            if (volume) {
+                                for (int i = 0; i < traits.nodeCount; ++i) {
+                                    for (int c = 0; c < 3; ++c) cellCenter[c] += double(geom[elem[i]][c]) / traits.nodeCount;
+                                }
+                            }
+                        });
 
-    Mesh(XdmfMeshLoader& loader, bool wireframe) : loader(loader) {
-        if (wireframe) 
-        mesh_line();
-        else
-        mesh_face();
-    }
+                        FaceNormal result = { { 0.0, 0.0, 0.0 }, volume };
+                        std::array<double, 3>& n = result.n;
+                        std::array<double, 3> faceCenter = { 0.0, 0.0, 0.0 };
+                        for (int k = 0; k < count; ++k) {
+                            const auto& p = geom[nodes[k]];
+                            const auto& q = geom[nodes[(k + 1) % count]];
+                            n[0] += (double(p[1]) - q[1]) * (double(p[2]) + q[2]);
+                            n[1] += (double(p[2]) - q[2]) * (double(p[0]) + q[0]);
+                            n[2] += (double(p[0]) - q[0]) * (double(p[1]) + q[1]);
+                            for (int c = 0; c < 3; ++c) faceCenter[c] += double(p[c]) / count;
+                        }
+                        if (volume) {
+                            double outward = 0.0;
+                            for (int c = 0; c < 3; ++c) outward += (faceCenter[c] - cellCenter[c]) * n[c];
+                            if (outward < 0.0) for (double& c : n) c = -c;
+                        }
+                        const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                        if (len > 0.0) for (double& c : n) c /= len;
+                        return result;
+                    };
+
+                    edges.ForEachEdge([&](uint64_t a, uint64_t b, const TaggedEdge* faces, size_t count) {
+                        if (count == 2) {
+                            const FaceNormal f0 = faceNormal(faces[0].tag);
+                            const FaceNormal f1 = faceNormal(faces[1].tag);
+                            double cosAngle = f0.n[0] * f1.n[0] + f0.n[1] * f1.n[1] + f0.n[2] * f1.n[2];
+                            // 有二维单元时朝向不可靠，只看两个面所在平面的夹角
+                            if (!f0.oriented || !f1.oriented) cosAngle = std::abs(cosAngle);
+                            if (cosAngle >= cosThreshold) return;
+                        }
+                        addEdge(a, b);
+                    });
+                });
+            }
+        }
 
-    void draw_triangle() const {
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(triangle_indices.size()), GL_UNSIGNED_INT, 0);
+        return lineIndices;
     }
 
-    void draw_line() const {
-        glBindVertexArray(VAO);
-        glDrawElements(GL_LINES, static_cast<GLsizei>(line_indices.size()), GL_UNSIGNED_INT, 0);
+    // 表面多边形：体单元只出现一次的面 + 二维单元本身（它唯一的“面”）。
+    // fn(faceId, nodes, 3 或 4)，faceId = e * 6 + 局部面号；面表在编译期确定，循环可以完全展开
+    template <uint8_t Type, typename Conn, typename Fn>
+    static void ForEachSurfaceFace(const FaceMatcher& matcher, const Conn& conn, size_t e, Fn&& fn) {
+        constexpr const ElementTraits& traits = *ElementTraitsFor(Type);
+        const uint64_t faceBase = static_cast<uint64_t>(e) * FaceMatcher::kMaxFacesPerCell;
+        ForEachCellFace(traits.faces, conn, [&](int f, const uint64_t* nodes, int count) {
+            if (traits.dimension == 2 || matcher.IsBoundary(e, f)) fn(faceBase + f, nodes, count);
+        });
     }
 
-    ~Mesh() {
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-    }
-private:
-    void AddEdges(std::vector<unsigned int>& indices, const std::vector<uint64_t>& conn, const std::initializer_list<std::pair<int,int>>& edges) {
-        for (auto [i, j] : edges) {
-            indices.push_back(static_cast<unsigned int>(conn[i]));
-            indices.push_back(static_cast<unsigned int>(conn[j]));
-        }
+    // 每 64K 个单元报告一次，开销可以忽略
+    void ReportProgress() {
+        if (!progress || (++elementsProcessed & 0xFFFF) != 0) return;
+        progress->Update(static_cast<float>(elementsProcessed) / static_cast<float>(progressTotal));
     }
 };
 
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
-    layout(location = 0) in vec3 aPos;
-    uniform mat4 uMVP;
+    layout(location = 0) in vec4 aPos;            // 量化时 xyz 是块内 0..65535 的坐标，w 是块号
+    layout(location = 1) in uint aPrimitiveBase;  // 这条绘制第一个三角形的编号，位置即 Mesh::kPrimitiveBaseAttribute
+    layout(std140) uniform FrameUniforms {
+        mat4 uMVP;
+    };
+    uniform bool uQuantized;
+    uniform samplerBuffer uChunkTable;  // 每块两个 texel：包围盒最小角、量化步长
+    flat out uint vPrimitiveBase;
     void main() {
-        gl_Position = uMVP * vec4(aPos, 1.0);
+        vec3 pos = aPos.xyz;
+        if (uQuantized) {
+            int chunk = int(aPos.w) * 2;
+            pos = texelFetch(uChunkTable, chunk).xyz + pos * texelFetch(uChunkTable, chunk + 1).xyz;
+        }
+        vPrimitiveBase = aPrimitiveBase;
+        gl_Position = uMVP * vec4(pos, 1.0);
     }
 )glsl";
 
@@ -641,17 +3780,75 @@ const char* fragmentShaderSource = R"glsl(
 )glsl";
 
 
+// 单遍线框：几何着色器给三角形的三个角分别输出重心坐标 (1,0,0) (0,1,0) (0,0,1)，
+// 片元离某条边的屏幕距离 = 对应分量 / 它的屏幕导数。uEdgeMasks 中为 0 的边（四边形对角线）
+// 把该分量固定为 1，不会被当成边。线宽由着色器决定，不受核心模式下 glLineWidth 的限制。
+const char* wireframeGeometryShaderSource = R"glsl(
+#version 330 core
+    layout(triangles) in;
+    layout(triangle_strip, max_vertices = 3) out;
+    uniform usamplerBuffer uEdgeMasks;
+    flat in uint vPrimitiveBase[];
+    noperspective out vec3 vBary;
+    void main() {
+        uint mask = texelFetch(uEdgeMasks, int(vPrimitiveBase[0]) + gl_PrimitiveIDIn).r;
+        vec3 hidden = vec3((mask & 1u) == 0u, (mask & 2u) == 0u, (mask & 4u) == 0u);
+        for (int i = 0; i < 3; ++i) {
+            vec3 bary = vec3(0.0);
+            bary[i] = 1.0;
+            vBary = max(bary, hidden);
+            gl_Position = gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+)glsl";
+
+
+const char* wireframeFragmentShaderSource = R"glsl(
+#version 330 core
+    noperspective in vec3 vBary;
+    out vec4 FragColor;
+    uniform vec3 uColor;
+    uniform vec3 uLineColor;
+    uniform float uLineWidth;  // 像素
+    void main() {
+        vec3 pixels = vBary / max(fwidth(vBary), vec3(1e-6));
+        float dist = min(min(pixels.x, pixels.y), pixels.z);
+        float line = 1.0 - smoothstep(uLineWidth * 0.5 - 0.5, uLineWidth * 0.5 + 0.5, dist);
+        FragColor = vec4(mix(uColor, uLineColor, line), 1.0);
+    }
+)glsl";
+
+
+// 每帧只变一次的公共参数，所有程序共用一个 uniform 缓冲区（见 FrameUniformBuffer）。
+// 着色器里声明为 layout(std140) uniform FrameUniforms，成员顺序和 std140 布局都要与这里一致
+struct FrameUniforms {
+    glm::mat4 mvp;
+};
+
+// 链接后反射出所有活动的 uniform、uniform 块和顶点属性，之后按名字查缓存，不再调用 glGet*Location。
+// 每帧、每次绘制都要设的 uniform 可以先用 uniformLocation 取句柄，再用接受句柄的 set 重载。
 class Shader {
 public:
     unsigned int ID;
 
-    Shader(const char* vertexSrc, const char* fragmentSrc) {
+    Shader(const char* vertexSrc, const char* fragmentSrc, const char* geometrySrc = nullptr) {
         // 编译顶点着色器
         unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vertexSrc, nullptr);
         glCompileShader(vertex);
         checkCompileErrors(vertex, "VERTEX");
 
+        // 编译几何着色器（可选）
+        unsigned int geometry = 0;
+        if (geometrySrc) {
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &geometrySrc, nullptr);
+            glCompileShader(geometry);
+            checkCompileErrors(geometry, "GEOMETRY");
+        }
+
         // 编译片元着色器
         unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fragmentSrc, nullptr);
@@ -661,28 +3858,111 @@ public:
         // 链接程序
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
+        if (geometry) glAttachShader(ID, geometry);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
 
         // 删除着色器对象
         glDeleteShader(vertex);
+        if (geometry) glDeleteShader(geometry);
         glDeleteShader(fragment);
+
+        reflect();
     }
 
     void use() const {
         glUseProgram(ID);
     }
 
-    void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    // 没有这个活动 uniform（未声明或被编译器优化掉）时返回 -1，对 -1 设值 GL 会忽略
+    int uniformLocation(const char* name) const {
+        auto it = uniforms.find(name);
+        return it != uniforms.end() ? it->second : -1;
+    }
+
+    // 没有这个活动顶点属性时返回 -1
+    int attributeLocation(const char* name) const {
+        auto it = attributes.find(name);
+        return it != attributes.end() ? it->second : -1;
+    }
+
+    // 把名为 name 的 uniform 块接到绑定点 binding；程序里没有这个块时返回 false
+    bool bindUniformBlock(const char* name, unsigned int binding) const {
+        auto it = uniformBlocks.find(name);
+        if (it == uniformBlocks.end()) return false;
+        glUniformBlockBinding(ID, it->second, binding);
+        return true;
+    }
+
+    void setMat4(int location, const glm::mat4& mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void setVec3(int location, const glm::vec3& value) const {
+        glUniform3fv(location, 1, glm::value_ptr(value));
+    }
+
+    void setFloat(int location, float value) const {
+        glUniform1f(location, value);
     }
 
-    void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+    void setInt(int location, int value) const {
+        glUniform1i(location, value);
     }
 
+    void setMat4(const char* name, const glm::mat4& mat) const { setMat4(uniformLocation(name), mat); }
+    void setVec3(const char* name, const glm::vec3& value) const { setVec3(uniformLocation(name), value); }
+    void setFloat(const char* name, float value) const { setFloat(uniformLocation(name), value); }
+    void setInt(const char* name, int value) const { setInt(uniformLocation(name), value); }
+
 private:
+    // std::less<> 让 find 直接接受 const char*，查找时不构造 std::string
+    std::map<std::string, int, std::less<>> uniforms;
+    std::map<std::string, unsigned int, std::less<>> uniformBlocks;
+    std::map<std::string, int, std::less<>> attributes;
+
+    void reflect() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+            std::string uniform(name.data(), length);
+            const GLint location = glGetUniformLocation(ID, uniform.c_str());
+            if (location < 0) continue;  // uniform 块的成员没有位置
+            // 数组报告为 "name[0]"，按不带下标的名字存
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) uniform.resize(uniform.size() - 3);
+            uniforms[uniform] = location;
+        }
+
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        name.resize(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, static_cast<GLuint>(i), maxLength, &length, name.data());
+            uniformBlocks[std::string(name.data(), length)] = static_cast<unsigned int>(i);
+        }
+
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        name.resize(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+            std::string attribute(name.data(), length);
+            const GLint location = glGetAttribLocation(ID, attribute.c_str());
+            if (location >= 0) attributes[attribute] = location;  // gl_VertexID 之类的内建变量没有位置
+        }
+    }
+
     void checkCompileErrors(unsigned int shader, const std::string& type) {
         int success;
         char infoLog[1024];
@@ -704,6 +3984,414 @@ private:
     }
 };
 
+// FrameUniforms 的 GPU 副本，每帧 update 一次；程序用 Shader::bindUniformBlock("FrameUniforms", kBinding) 接上。
+// 每帧写进流式缓冲区的下一段再把绑定点指过去，不会等上一帧还在用的那份
+class FrameUniformBuffer {
+public:
+    static constexpr unsigned int kBinding = 0;
+
+    FrameUniformBuffer() : stream(GL_UNIFORM_BUFFER, UniformOffsetAlignment()) {}
+    FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+    FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+    void update(const FrameUniforms& data) {
+        std::memcpy(stream.Begin(sizeof(FrameUniforms)), &data, sizeof(FrameUniforms));
+        const size_t offset = stream.End();
+        glBindBufferRange(GL_UNIFORM_BUFFER, kBinding, stream.Buffer(), static_cast<GLintptr>(offset), sizeof(FrameUniforms));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    static size_t UniformOffsetAlignment() {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return static_cast<size_t>(std::max(alignment, 1));
+    }
+
+    StreamBuffer stream;
+};
+
+void MeshGeometry::bindChunkTable(const Shader& shader, int unit) const {
+    shader.setInt("uQuantized", quantized ? 1 : 0);
+    if (chunkTableTexture == 0) return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, chunkTableTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::draw(const Shader& shader, const std::vector<uint8_t>* visibleChunks,
+                const std::vector<int32_t>* lodChoice) const {
+    glBindVertexArray(VAO);
+    geometry->bindChunkTable(shader, 1);
+    if (edgeMaskTexture != 0) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, edgeMaskTexture);
+    }
+    // 没有间接绘制又要逐段数据（单遍线框）时只能一段一个 draw call
+    const int primitiveBaseLocation = shader.attributeLocation("aPrimitiveBase");
+    const bool perRangeDraws = drawSlotBuffer == 0 && primitiveBaseLocation >= 0;
+    submitter.Clear();
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        DrawRange range = ranges[r];
+        if (visibleChunks && !(*visibleChunks)[range.chunk]) continue;
+        uint32_t slot = static_cast<uint32_t>(r);
+        if (lodChoice && (*lodChoice)[r] >= 0) {
+            const LodLevel& lod = lods[(*lodChoice)[r]];
+            range.firstIndex = lod.firstIndex;
+            range.indexCount = lod.indexCount;
+            slot = static_cast<uint32_t>(ranges.size() + (*lodChoice)[r]);
+        }
+        const uint32_t baseVertex = geometry->chunks[range.chunk].baseVertex;
+        if (perRangeDraws) {
+            glVertexAttribI1ui(static_cast<GLuint>(primitiveBaseLocation), static_cast<GLuint>(range.firstIndex / 3));
+            glDrawElementsBaseVertex(mode, static_cast<GLsizei>(range.indexCount), GL_UNSIGNED_SHORT,
+                                     reinterpret_cast<const void*>(range.firstIndex * sizeof(uint16_t)),
+                                     static_cast<GLint>(baseVertex));
+        } else {
+            submitter.Add(range.indexCount, range.firstIndex, baseVertex, slot);
+        }
+    }
+    submitter.Submit(mode);
+}
+
+// ============ 遮挡剔除 ================
+
+// 深度金字塔的 CPU 副本。第 0 层是从 GPU 读回的那一层，每个格子是屏幕上 cellSize×cellSize 像素块的最大深度；
+// 往上每层取 2×2 的最大值。各层尺寸向上取整，第 L 层的格子正好覆盖屏幕 [x·cellSize·2^L, (x+1)·cellSize·2^L)。
+class DepthPyramid {
+public:
+    // depth 按行存放，第 0 行是屏幕最下面一行（glReadPixels 的顺序）；mvp 是画出这份深度时用的矩阵
+    void Build(const float* depth, int width, int height, int cellSize, int screenWidth, int screenHeight,
+               const glm::mat4& mvp) {
+        this->cellSize = cellSize;
+        this->screenWidth = screenWidth;
+        this->screenHeight = screenHeight;
+        captureMvp = mvp;
+        inverseMvp = glm::inverse(mvp);
+
+        levels.clear();
+        levels.push_back({ width, height, std::vector<float>(depth, depth + size_t(width) * height) });
+        while (levels.back().width > 1 || levels.back().height > 1) {
+            const Level& src = levels.back();
+            Level dst{ (src.width + 1) / 2, (src.height + 1) / 2, {} };
+            dst.depth.resize(size_t(dst.width) * dst.height);
+            for (int y = 0; y < dst.height; ++y) {
+                for (int x = 0; x < dst.width; ++x) {
+                    const int x1 = std::min(x * 2 + 1, src.width - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+                    dst.depth[size_t(y) * dst.width + x] =
+                        std::max(std::max(src.At(x * 2, y * 2), src.At(x1, y * 2)), std::max(src.At(x * 2, y1), src.At(x1, y1)));
+                }
+            }
+            levels.push_back(std::move(dst));
+        }
+    }
+
+    void Clear() { levels.clear(); }
+    bool Empty() const { return levels.empty(); }
+    int ScreenWidth() const { return screenWidth; }
+    int ScreenHeight() const { return screenHeight; }
+
+    // 捕获时看到的表面换成 current 的相机后在屏幕上最多移动多少像素（稀疏采样估计）。
+    // 有采样点跑到相机平面后面时返回无穷大
+    float MaxScreenMotion(const glm::mat4& current) const {
+        if (levels.empty()) return std::numeric_limits<float>::infinity();
+        const Level& base = levels.front();
+        const int stepX = std::max(1, base.width / kMotionSamples), stepY = std::max(1, base.height / kMotionSamples);
+        float motion = 0.0f;
+        for (int y = stepY / 2; y < base.height; y += stepY) {
+            for (int x = stepX / 2; x < base.width; x += stepX) {
+                const float depth = base.At(x, y);
+                if (depth >= 1.0f) continue;  // 背景
+                const glm::vec2 before((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+                const glm::vec4 ndc(before.x / screenWidth * 2.0f - 1.0f, before.y / screenHeight * 2.0f - 1.0f,
+                                    depth * 2.0f - 1.0f, 1.0f);
+                glm::vec4 world = inverseMvp * ndc;
+                if (std::abs(world.w) < 1e-12f) continue;
+                world /= world.w;
+                const glm::vec4 clip = current * world;
+                if (clip.w <= 0.0f) return std::numeric_limits<float>::infinity();
+                const glm::vec2 after((clip.x / clip.w * 0.5f + 0.5f) * screenWidth, (clip.y / clip.w * 0.5f + 0.5f) * screenHeight);
+                motion = std::max(motion, glm::length(after - before));
+            }
+        }
+        return motion;
+    }
+
+    // 包围盒在 current 下最近的点比它覆盖区域（向外扩 dilate 像素）内的最大深度还远，就一定被挡住。
+    // 跨过近平面或完全在屏幕外的盒子不做判断（后者交给视锥剔除），一律算可见
+    bool Occluded(const glm::mat4& current, const float lo[3], const float hi[3], float dilate) const {
+        if (levels.empty()) return false;
+        float minX = std::numeric_limits<float>::max(), minY = minX, nearest = minX;
+        float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        for (int corner = 0; corner < 8; ++corner) {
+            const glm::vec4 clip = current * glm::vec4(corner & 1 ? hi[0] : lo[0], corner & 2 ? hi[1] : lo[1],
+                                                       corner & 4 ? hi[2] : lo[2], 1.0f);
+            if (clip.w <= 0.0f || clip.z < -clip.w) return false;
+            const float x = (clip.x / clip.w * 0.5f + 0.5f) * screenWidth;
+            const float y = (clip.y / clip.w * 0.5f + 0.5f) * screenHeight;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+        }
+        minX -= dilate; minY -= dilate;
+        maxX += dilate; maxY += dilate;
+        if (maxX < 0.0f || maxY < 0.0f || minX >= float(screenWidth) || minY >= float(screenHeight)) return false;
+
+        // 从第 0 层往上找，直到覆盖的格子不超过 4×4
+        int x0 = int(std::max(minX, 0.0f)) / cellSize, x1 = int(std::min(maxX, float(screenWidth - 1))) / cellSize;
+        int y0 = int(std::max(minY, 0.0f)) / cellSize, y1 = int(std::min(maxY, float(screenHeight - 1))) / cellSize;
+        size_t level = 0;
+        while ((x1 - x0 >= 4 || y1 - y0 >= 4) && level + 1 < levels.size()) {
+            x0 >>= 1; x1 >>= 1; y0 >>= 1; y1 >>= 1;
+            ++level;
+        }
+        const Level& l = levels[level];
+        float farthest = 0.0f;
+        for (int y = y0; y <= std::min(y1, l.height - 1); ++y) {
+            for (int x = x0; x <= std::min(x1, l.width - 1); ++x) farthest = std::max(farthest, l.At(x, y));
+        }
+        return nearest > farthest;
+    }
+
+private:
+    static constexpr int kMotionSamples = 16;  // 估计屏幕运动时每个方向的采样数
+
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<float> depth;
+        float At(int x, int y) const { return depth[size_t(y) * width + x]; }
+    };
+
+    std::vector<Level> levels;
+    int cellSize = 1;
+    int screenWidth = 0, screenHeight = 0;
+    glm::mat4 captureMvp{ 1.0f }, inverseMvp{ 1.0f };
+};
+
+
+// 全屏三角形，不需要顶点缓冲区
+const char* fullscreenVertexShaderSource = R"glsl(
+#version 330 core
+    void main() {
+        vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+    }
+)glsl";
+
+
+// 深度金字塔的一层：取上一层对应 2×2 的最大值，奇数边上越界的取最后一行/列
+const char* depthReduceFragmentShaderSource = R"glsl(
+#version 330 core
+    uniform sampler2D uDepth;
+    out float FragDepth;
+    void main() {
+        ivec2 last = textureSize(uDepth, 0) - 1;
+        ivec2 p = ivec2(gl_FragCoord.xy) * 2;
+        float a = texelFetch(uDepth, min(p, last), 0).r;
+        float b = texelFetch(uDepth, min(p + ivec2(1, 0), last), 0).r;
+        float c = texelFetch(uDepth, min(p + ivec2(0, 1), last), 0).r;
+        float d = texelFetch(uDepth, min(p + ivec2(1, 1), last), 0).r;
+        FragDepth = max(max(a, b), max(c, d));
+    }
+)glsl";
+
+
+// 层次深度（Hi-Z）遮挡剔除。每帧场景画完后 Capture 把深度缓冲复制出来，在 GPU 上逐层取 2×2 最大值，
+// 把不超过 kReadbackSize 的那一层通过 PBO 异步读回（fence 到了才取，不等 GPU），CPU 上补齐更粗的层。
+// 之后的帧在 Cull 里用这份“上一帧”的深度测试各块的包围盒。
+// 深度是几帧前的，相机动了会有误差：按采样估计出的屏幕运动量扩大包围盒的测试区域，
+// 运动超过 kCameraCutMotion（镜头切换、窗口尺寸变化、刚换模型）时这一帧不剔除，等新的深度读回。
+class OcclusionCuller {
+public:
+    static constexpr int kReadbackSize = 256;
+    static constexpr float kCameraCutMotion = 0.05f;  // 相对窗口较长边
+
+    OcclusionCuller() : reduceShader(fullscreenVertexShaderSource, depthReduceFragmentShaderSource) {
+        glGenVertexArrays(1, &emptyVAO);
+        reduceShader.use();
+        reduceShader.setInt("uDepth", 0);
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    ~OcclusionCuller() {
+        DropPending();
+        Release();
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    bool Supported() const { return supported; }
+    bool CameraCut() const { return cameraCut; }
+
+    // 换模型时调用，旧的深度不能再用
+    void Invalidate() {
+        DropPending();
+        pyramid.Clear();
+    }
+
+    // 对 visible 中标记可见的块做遮挡测试，被挡住的清零，返回剔除的块数
+    size_t Cull(const glm::mat4& mvp, int width, int height, const std::vector<VertexChunk>& chunks,
+                std::vector<uint8_t>& visible) {
+        cameraCut = false;
+        if (!supported || pyramid.Empty()) return 0;
+        const float motion = pyramid.MaxScreenMotion(mvp);
+        if (width != pyramid.ScreenWidth() || height != pyramid.ScreenHeight() ||
+            !(motion <= kCameraCutMotion * std::max(width, height))) {
+            cameraCut = true;
+            return 0;
+        }
+        size_t culled = 0;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            if (visible[c] && pyramid.Occluded(mvp, chunks[c].boundsMin, chunks[c].boundsMax, motion + 1.0f)) {
+                visible[c] = 0;
+                ++culled;
+            }
+        }
+        return culled;
+    }
+
+    // 在场景画完、交换缓冲区之前调用。上一次的读回还没完成时什么都不做
+    void Capture(int width, int height, const glm::mat4& mvp) {
+        if (!supported || width <= 0 || height <= 0) return;
+        if (fence != nullptr && !FinishReadback()) return;
+
+        if (width != screenWidth || height != screenHeight) Allocate(width, height);
+
+        while (glGetError() != GL_NO_ERROR) {}
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+        glDisable(GL_DEPTH_TEST);
+        reduceShader.use();
+        glBindVertexArray(emptyVAO);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, levels[i].framebuffer);
+            glViewport(0, 0, levels[i].width, levels[i].height);
+            glBindTexture(GL_TEXTURE_2D, i == 0 ? depthTexture : levels[i - 1].texture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+
+        const Level& last = levels.back();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+        glReadPixels(0, 0, last.width, last.height, GL_RED, GL_FLOAT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pendingMvp = mvp;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glEnable(GL_DEPTH_TEST);
+
+        // 多重采样的默认帧缓冲区等情况下深度复制不了，这时关掉遮挡剔除
+        if (glGetError() != GL_NO_ERROR) {
+            std::cerr << "Warning: cannot read back the depth buffer, occlusion culling disabled" << std::endl;
+            supported = false;
+            Invalidate();
+        }
+    }
+
+private:
+    struct Level {
+        unsigned int texture = 0, framebuffer = 0;
+        int width = 0, height = 0;
+    };
+
+    Shader reduceShader;
+    unsigned int emptyVAO = 0;
+    unsigned int depthTexture = 0;
+    unsigned int readbackBuffer = 0;
+    std::vector<Level> levels;  // GPU 上缩小的各层，最后一层读回
+    int screenWidth = 0, screenHeight = 0;
+    GLsync fence = nullptr;
+    glm::mat4 pendingMvp{ 1.0f };
+    DepthPyramid pyramid;
+    bool supported = true;
+    bool cameraCut = false;
+
+    // fence 已经到了就把读回的数据建成 CPU 金字塔，返回 true；还没到返回 false
+    bool FinishReadback() {
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+        glDeleteSync(fence);
+        fence = nullptr;
+        if (status == GL_WAIT_FAILED) return true;
+
+        const Level& last = levels.back();
+        const size_t bytes = size_t(last.width) * last.height * sizeof(float);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+        if (const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT)) {
+            pyramid.Build(static_cast<const float*>(data), last.width, last.height, 1 << levels.size(),
+                          screenWidth, screenHeight, pendingMvp);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+
+    void DropPending() {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // 按窗口尺寸重建深度纹理和各层；至少缩一层，读回的总是 R32F 颜色纹理
+    void Allocate(int width, int height) {
+        Release();
+        screenWidth = width;
+        screenHeight = height;
+
+        auto makeTexture = [](GLint internalFormat, int w, int h, GLenum format, GLenum type) {
+            unsigned int texture = 0;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, nullptr);
+            // texelFetch 也要求纹理完整，没有 mipmap 就不能用默认的缩小过滤方式
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            return texture;
+        };
+        depthTexture = makeTexture(GL_DEPTH_COMPONENT24, width, height, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+
+        int w = width, h = height;
+        do {
+            Level level;
+            level.width = w = (w + 1) / 2;
+            level.height = h = (h + 1) / 2;
+            level.texture = makeTexture(GL_R32F, w, h, GL_RED, GL_FLOAT);
+            glGenFramebuffers(1, &level.framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, level.framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+            levels.push_back(level);
+        } while (w > kReadbackSize || h > kReadbackSize);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenBuffers(1, &readbackBuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size_t(w) * h * sizeof(float), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    void Release() {
+        for (const Level& level : levels) {
+            glDeleteFramebuffers(1, &level.framebuffer);
+            glDeleteTextures(1, &level.texture);
+        }
+        levels.clear();
+        if (depthTexture != 0) glDeleteTextures(1, &depthTexture);
+        if (readbackBuffer != 0) glDeleteBuffers(1, &readbackBuffer);
+        depthTexture = readbackBuffer = 0;
+        screenWidth = screenHeight = 0;
+    }
+};
+
+
 enum Camera_Movement {
     FORWARD,
     BACKWARD,
@@ -865,25 +4553,25 @@ public:
         camera->ProcessMouseScroll((float)yoffset);
     }
 
-    // 处理键盘输入
-    void onKey(GLFWwindow* window, float deltaTime) {
-        if (!camera) return;
-
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            camera->ProcessKeyboard(FORWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            camera->ProcessKeyboard(BACKWARD, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            camera->ProcessKeyboard(LEFT, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            camera->ProcessKeyboard(RIGHT, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-            camera->ProcessKeyboard(UP, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-            camera->ProcessKeyboard(DOWN, deltaTime);
+    // 处理键盘输入；按住移动键时相机每帧都在动，返回 true
+    bool onKey(GLFWwindow* window, float deltaTime) {
+        if (!camera) return false;
+
+        bool moved = false;
+        const std::pair<int, Camera_Movement> keys[] = {
+            { GLFW_KEY_W, FORWARD }, { GLFW_KEY_S, BACKWARD }, { GLFW_KEY_A, LEFT },
+            { GLFW_KEY_D, RIGHT },   { GLFW_KEY_SPACE, UP },   { GLFW_KEY_LEFT_SHIFT, DOWN },
+        };
+        for (const auto& [key, direction] : keys) {
+            if (glfwGetKey(window, key) == GLFW_PRESS) {
+                camera->ProcessKeyboard(direction, deltaTime);
+                moved = true;
+            }
+        }
 
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
+        return moved;
     }
 
     // 重置首次鼠标位置，外部可调用（例如切换窗口时）
@@ -921,8 +4609,187 @@ public:
 
 
 
+class ModelLoadTask;
+
 void imgui_init(Application &app);
-void imgui_draw();
+void imgui_draw(ModelLoadTask* loadTask);
+
+// 加载模型并生成面 / 线两个 Mesh（只在 CPU 上，调用方负责 upload()）。
+// 缓存有效时 Mesh 直接引用缓存文件里映射出来的缓冲区，
+// 否则完整加载 XDMF + HDF5 做一遍提取，再把结果写回缓存。
+void LoadModelMeshes(const std::string& xdmfPath, const MeshBuildOptions& options,
+                     std::unique_ptr<Mesh>& face, std::unique_ptr<Mesh>& line, std::array<double, 3>& origin,
+                     LoadProgress* progress = nullptr) {
+    const std::string cachePath = MeshCache::PathFor(xdmfPath);
+    const std::string key = MeshCache::KeyFor(xdmfPath, options);
+
+    if (progress) progress->Begin(LoadStage::ReadCache);
+    auto cache = std::make_shared<MeshCache>();
+    if (cache->Open(cachePath, key)) {
+        size_t originCount = 0;
+        const double* cachedOrigin = cache->Section<double>(MeshCache::Origin, originCount);
+        origin = { 0.0, 0.0, 0.0 };
+        if (cachedOrigin && originCount == 3) origin = { cachedOrigin[0], cachedOrigin[1], cachedOrigin[2] };
+
+        // 顶点和索引都直接引用映射内存，块表和绘制列表很小，复制一份
+        auto geometry = std::make_shared<MeshGeometry>();
+        face = std::make_unique<Mesh>(geometry, GL_TRIANGLES);
+        line = std::make_unique<Mesh>(geometry, GL_LINES);
+        size_t vertexCount = 0, faceCount = 0, lineCount = 0;
+        std::vector<VertexChunk> chunks = cache->SectionCopy<VertexChunk>(MeshCache::VertexChunks);
+        const uint16_t* quantizedVertices = cache->Section<uint16_t>(MeshCache::QuantizedVertices, vertexCount);
+        if (vertexCount > 0) {
+            geometry->SetQuantizedVertices(quantizedVertices, vertexCount / 4, std::move(chunks), cache);
+        } else {
+            const float* vertices = cache->Section<float>(MeshCache::Vertices, vertexCount);
+            geometry->SetVertices(vertices, vertexCount / 3, std::move(chunks), cache);
+        }
+        const uint16_t* faceIndices = cache->Section<uint16_t>(MeshCache::FaceIndices, faceCount);
+        face->SetIndices(faceIndices, faceCount, cache->SectionCopy<DrawRange>(MeshCache::FaceRanges), cache);
+        const uint16_t* lineIndices = cache->Section<uint16_t>(MeshCache::LineIndices, lineCount);
+        line->SetIndices(lineIndices, lineCount, cache->SectionCopy<DrawRange>(MeshCache::LineRanges), cache);
+        size_t maskCount = 0;
+        const uint8_t* edgeMasks = cache->Section<uint8_t>(MeshCache::FaceEdgeMasks, maskCount);
+        face->SetEdgeMasks(edgeMasks, maskCount, cache);
+        face->SetLods(cache->SectionCopy<LodLevel>(MeshCache::FaceLods));
+        std::cout << "Loaded render mesh from cache: " << cachePath << std::endl;
+        return;
+    }
+
+    {
+        // loader 只活到提取结束，写缓存时已释放
+        XdmfMeshLoader loader;
+        loader.singlePrecision = options.singlePrecision;
+        loader.progress = progress;
+        loader.Load(xdmfPath);
+        origin = loader.origin;
+        RenderMeshBuilder(loader, options, progress).Build(face, line);
+    }
+
+    if (progress) progress->Begin(LoadStage::WriteCache);
+    const MeshGeometry& geometry = *face->geometry;
+    std::vector<MeshCache::SectionData> sections = {
+        { MeshCache::Vertices,          sizeof(float),       geometry.vertices.data(),           geometry.vertices.size() },
+        { MeshCache::QuantizedVertices, sizeof(uint16_t),    geometry.quantized_vertices.data(), geometry.quantized_vertices.size() },
+        { MeshCache::VertexChunks,      sizeof(VertexChunk), geometry.chunks.data(),             geometry.chunks.size() },
+        { MeshCache::FaceIndices,       sizeof(uint16_t),    face->indices.data(),               face->indices.size() },
+        { MeshCache::FaceRanges,        sizeof(DrawRange),   face->ranges.data(),                face->ranges.size() },
+        { MeshCache::FaceEdgeMasks,     sizeof(uint8_t),     face->edge_masks.data(),            face->edge_masks.size() },
+        { MeshCache::LineIndices,       sizeof(uint16_t),    line->indices.data(),               line->indices.size() },
+        { MeshCache::LineRanges,        sizeof(DrawRange),   line->ranges.data(),                line->ranges.size() },
+        { MeshCache::Origin,            sizeof(double),      origin.data(),                      origin.size() },
+        { MeshCache::FaceLods,          sizeof(LodLevel),    face->lods.data(),                  face->lods.size() },
+    };
+    if (!MeshCache::Write(cachePath, key, sections)) {
+        std::cerr << "Failed to write render mesh cache: " << cachePath << std::endl;
+    }
+}
+
+// 在后台线程里跑 LoadModelMeshes，窗口照常刷新。
+// OpenGL 上下文只属于渲染线程，所以工作线程只准备 CPU 数据，TakeResult 在渲染线程里上传 GPU。
+class ModelLoadTask {
+public:
+    LoadProgress progress;
+
+    ModelLoadTask() = default;
+    ModelLoadTask(const ModelLoadTask&) = delete;
+    ModelLoadTask& operator=(const ModelLoadTask&) = delete;
+
+    ~ModelLoadTask() {
+        progress.Cancel();
+        if (worker.joinable()) worker.join();
+    }
+
+    void Start(const std::string& xdmfPath, const MeshBuildOptions& options) {
+        path = xdmfPath;
+        startTime = glfwGetTime();
+        worker = std::thread([this, xdmfPath, options]() {
+            try {
+                LoadModelMeshes(xdmfPath, options, face, line, origin, &progress);
+                progress.Finish(LoadStage::Done);
+            } catch (const LoadCancelled&) {
+                face.reset();
+                line.reset();
+                progress.Finish(LoadStage::Cancelled);
+            } catch (const std::exception& e) {
+                face.reset();
+                line.reset();
+                error = e.what();
+                progress.Finish(LoadStage::Failed);
+            }
+            finished = true;
+            glfwPostEmptyEvent();  // 主循环可能正睡在 glfwWaitEventsTimeout 里
+        });
+    }
+
+    void Cancel() { progress.Cancel(); }
+
+    bool Running() const { return worker.joinable() && !finished; }
+    bool Pending() const { return worker.joinable() && !taken; }  // 还在加载，或者结果还没被 TakeResult 取走
+    bool Finished() const { return finished; }
+    const std::string& Path() const { return path; }
+    const std::string& Error() const { return error; }  // 只在 Finished() 之后读
+    double Elapsed() const { return (taken ? endTime : glfwGetTime()) - startTime; }
+
+    // 工作线程结束后由渲染线程调用：上传 GPU 并交出网格。只会成功一次。
+    bool TakeResult(std::unique_ptr<Mesh>& faceOut, std::unique_ptr<Mesh>& lineOut, std::array<double, 3>& originOut) {
+        if (!finished || taken) return false;
+        worker.join();
+        taken = true;
+        endTime = glfwGetTime();
+        if (progress.Stage() != LoadStage::Done) return false;
+
+        face->upload();
+        line->upload();
+        faceOut = std::move(face);
+        lineOut = std::move(line);
+        originOut = origin;
+        return true;
+    }
+
+private:
+    std::thread worker;
+    std::atomic<bool> finished{ false };
+    bool taken = false;
+    std::string path;
+    std::string error;
+    double startTime = 0.0;
+    double endTime = 0.0;
+
+    // 工作线程写，finished 置位后才由渲染线程读
+    std::unique_ptr<Mesh> face, line;
+    std::array<double, 3> origin = { 0.0, 0.0, 0.0 };
+};
+
+// 按需重绘：相机、界面、数据有变化时标记，没有标记时主循环睡在 glfwWaitEventsTimeout 里，空闲时几乎不占 CPU。
+// 交互（输入事件、相机移动、加载完成）标记后连续画 kBurstSeconds：交互期间帧率平稳，
+// 依赖前几帧结果的部分（遮挡剔除的深度回读、ImGui 对上一帧点击的响应）在停下后也能收敛。
+// 只需要刷新一次的（加载进度）用 RequestFrame。
+class RedrawScheduler {
+public:
+    static constexpr double kBurstSeconds = 0.25;
+    static constexpr double kLoadingRefreshSeconds = 0.1;  // 加载期间进度条的刷新间隔
+    static constexpr double kIdleWaitSeconds = 1.0;
+
+    void MarkDirty() {
+        burstUntil = glfwGetTime() + kBurstSeconds;
+        frameRequested = true;
+    }
+
+    void RequestFrame() { frameRequested = true; }
+
+    bool NeedsFrame() const { return frameRequested || glfwGetTime() < burstUntil; }
+
+    // 每帧开始时调用，之后的标记留给下一帧
+    void BeginFrame() { frameRequested = false; }
+
+private:
+    double burstUntil = 0.0;
+    bool frameRequested = true;  // 第一帧总要画
+};
+
+RedrawScheduler redraw;
+bool renderOnDemand = true;
 
 // 帧间隔时间
 float deltaTime = 0.0f; 
@@ -930,11 +4797,39 @@ float lastFrame = 0.0f;
 
 Camera camera;
 
+// 线框叠加方式：true 时表面和线框一遍画完（重心坐标着色器），false 时再画一遍 GL_LINES
+bool singlePassWireframe = true;
+
+// 视锥剔除：每帧在 CPU 上用块的层次包围盒挑出与视锥相交的块，只提交这些块的 draw call
+bool frustumCulling = true;
+size_t visibleChunkCount = 0;
+size_t totalChunkCount = 0;
+
+// 遮挡剔除：用前几帧的层次深度再去掉被挡住的块（见 OcclusionCuller）
+bool occlusionCulling = true;
+size_t occludedChunkCount = 0;
+bool occlusionCameraCut = false;
+
+// 细节层次：每块按投影误差选预先简化的一级，误差不超过 lodPixelError 像素
+bool levelOfDetail = true;
+float lodPixelError = 1.0f;
+size_t drawnTriangleCount = 0;
+size_t fullTriangleCount = 0;
+
 
 int main(int argc, char** argv) {
     Application app;
     if (!app.init(1600, 1200, "Dynamic Vertex Color Demo")) return -1;
 
+    // 任何输入、窗口变化都要重画；在 imgui_init 之前设置，ImGui 装自己的回调时会链式调用这些
+    glfwSetKeyCallback(app.window, [](GLFWwindow*, int, int, int, int) { redraw.MarkDirty(); });
+    glfwSetCharCallback(app.window, [](GLFWwindow*, unsigned int) { redraw.MarkDirty(); });
+    glfwSetMouseButtonCallback(app.window, [](GLFWwindow*, int, int, int) { redraw.MarkDirty(); });
+    glfwSetScrollCallback(app.window, [](GLFWwindow*, double, double) { redraw.MarkDirty(); });
+    glfwSetWindowFocusCallback(app.window, [](GLFWwindow*, int) { redraw.MarkDirty(); });
+    glfwSetWindowSizeCallback(app.window, [](GLFWwindow*, int, int) { redraw.MarkDirty(); });
+    glfwSetWindowRefreshCallback(app.window, [](GLFWwindow*) { redraw.MarkDirty(); });
+
     imgui_init(app);
 
     CameraController controller;
@@ -958,6 +4853,7 @@ int main(int argc, char** argv) {
         if (controller) {
             controller->onMouseMove(xpos, ypos);
         }
+        redraw.MarkDirty();
     });
 
     glfwSetInputMode(app.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // 隐藏光标并锁定到窗口中央
@@ -974,22 +4870,61 @@ int main(int argc, char** argv) {
 
         
     Shader shader(vertexShaderSource, fragmentShaderSource);
+    Shader wireframeShader(vertexShaderSource, wireframeFragmentShaderSource, wireframeGeometryShaderSource);
+    wireframeShader.use();
+    wireframeShader.setInt("uEdgeMasks", 0);
+    wireframeShader.setInt("uChunkTable", 1);
+    shader.use();
+    shader.setInt("uChunkTable", 1);  // 0 号单元上绑着边标记（整数纹理），块表不能和它共用
+    // MVP 每帧写一次，两个程序共用
+    FrameUniformBuffer frameUniforms;
+    shader.bindUniformBlock("FrameUniforms", FrameUniformBuffer::kBinding);
+    wireframeShader.bindUniformBlock("FrameUniforms", FrameUniformBuffer::kBinding);
+    const int colorLocation = shader.uniformLocation("uColor");
+    const int wireframeColorLocation = wireframeShader.uniformLocation("uColor");
+    const int lineColorLocation = wireframeShader.uniformLocation("uLineColor");
+    const int lineWidthLocation = wireframeShader.uniformLocation("uLineWidth");
+    // 间接绘制时 aPrimitiveBase 来自 VAO 上固定位置的实例属性，位置对不上线框会静默画错
+    if (wireframeShader.attributeLocation("aPrimitiveBase") != static_cast<int>(Mesh::kPrimitiveBaseAttribute)) {
+        std::cerr << "Wireframe shader: aPrimitiveBase is not at location " << Mesh::kPrimitiveBaseAttribute
+                  << ", single-pass wireframe disabled" << std::endl;
+        singlePassWireframe = false;
+    }
+    OcclusionCuller occlusion;
 
-    XdmfMeshLoader loader;
-    loader.Load("model_big.xdmf");
-    Mesh mesh_line(loader, true);
-    Mesh mesh_face(loader, false);
+    std::unique_ptr<Mesh> mesh_line;
+    std::unique_ptr<Mesh> mesh_face;
+    // 只做显示，用单精度 + 平移到包围盒中心；modelOrigin 加回去就是模型原始坐标
+    MeshBuildOptions buildOptions;
+    buildOptions.singlePrecision = true;
+    buildOptions.quantizePositions = true;  // 顶点 16 位量化，大模型显存和顶点带宽约减半
+    buildOptions.lodLevels = 6;             // 表面块预先简化，远处的块画粗的级别
+    std::array<double, 3> modelOrigin = { 0.0, 0.0, 0.0 };
+
+    // 后台加载，窗口和 ImGui 在加载期间照常刷新；加载完成的那一帧在这里上传 GPU
+    ModelLoadTask modelLoad;
+    modelLoad.Start("model_big.xdmf", buildOptions);
 
     glLineWidth(2.0f);  // 默认是1像素，太细也会导致看起来像断线
     
     float time = 0.0f;
 
     while (!app.shouldClose()) {
+        redraw.BeginFrame();
         float currentFrame = float(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        controller.onKey(app.window, deltaTime);
+        if (controller.onKey(app.window, deltaTime)) redraw.MarkDirty();
+
+        if (modelLoad.TakeResult(mesh_face, mesh_line, modelOrigin)) {
+            std::cout << "Model origin: " << modelOrigin[0] << ", " << modelOrigin[1] << ", " << modelOrigin[2] << std::endl;
+            occlusion.Invalidate();
+            redraw.MarkDirty();
+        }
+
+        int framebufferWidth = 0, framebufferHeight = 0;
+        glfwGetFramebufferSize(app.window, &framebufferWidth, &framebufferHeight);
 
         glClearColor(0.1f, 0.1f, 0.15f, 1.0f);  // 设置底色
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // 清屏，用底色覆盖整个窗口, 启用深度测试
@@ -1003,26 +4938,85 @@ int main(int argc, char** argv) {
 
         // 这几行要保证顺序
         // mesh.updateVertices(time);
+        frameUniforms.update({ mvp });
         shader.use();
-        shader.setMat4("uMVP", mvp);
 
-        shader.setVec3("uColor", glm::vec3(0.0f, 0.0f, 0.0f));
-        mesh_face.draw_triangle();
+        // 面和线共用顶点块，剔除结果两遍共用
+        std::vector<uint8_t> visibleChunks;
+        const std::vector<uint8_t>* visible = nullptr;
+        occludedChunkCount = 0;
+        occlusionCameraCut = false;
+        if (mesh_face) {
+            const MeshGeometry& geometry = *mesh_face->geometry;
+            totalChunkCount = geometry.chunks.size();
+            visibleChunkCount = totalChunkCount;
+            if (frustumCulling) {
+                visibleChunkCount = geometry.bvh.Cull(Frustum(mvp), visibleChunks);
+                visible = &visibleChunks;
+            }
+            if (occlusionCulling) {
+                if (!visible) visibleChunks.assign(totalChunkCount, 1);
+                occludedChunkCount = occlusion.Cull(mvp, framebufferWidth, framebufferHeight, geometry.chunks, visibleChunks);
+                occlusionCameraCut = occlusion.CameraCut();
+                visibleChunkCount -= occludedChunkCount;
+                visible = &visibleChunks;
+            }
+        }
+
+        // 只有表面有简化级别，线框的 GL_LINES 总是画原始的边
+        std::vector<int32_t> lodChoice;
+        const std::vector<int32_t>* lod = nullptr;
+        if (mesh_face) {
+            if (levelOfDetail && mesh_face->HasLods()) {
+                mesh_face->SelectLods(mvp, framebufferHeight, lodPixelError, lodChoice);
+                lod = &lodChoice;
+            }
+            drawnTriangleCount = mesh_face->TriangleCount(visible, lod);
+            fullTriangleCount = mesh_face->TriangleCount(nullptr, nullptr);
+        }
+
+        // 单遍线框只能画表面多边形的边；All 模式的内部边、特征边仍走 GL_LINES
+        const bool surfaceEdges = buildOptions.edgeMode == EdgeMode::Boundary && buildOptions.creaseAngle <= 0.0f;
+        if (mesh_face && singlePassWireframe && surfaceEdges && mesh_face->HasEdgeMasks()) {
+            wireframeShader.use();
+            wireframeShader.setVec3(wireframeColorLocation, glm::vec3(0.0f, 0.0f, 0.0f));
+            wireframeShader.setVec3(lineColorLocation, glm::vec3(1.0f, 1.0f, 1.0f));
+            wireframeShader.setFloat(lineWidthLocation, 2.0f);
+            mesh_face->draw(wireframeShader, visible, lod);
+        } else if (mesh_face && mesh_line) {
+            shader.setVec3(colorLocation, glm::vec3(0.0f, 0.0f, 0.0f));
+            mesh_face->draw(shader, visible, lod);
+
+            glEnable(GL_POLYGON_OFFSET_LINE);
+            glPolygonOffset(-1.0f, -1.0f);  // 负值让线“浮”在表面上
+            shader.setVec3(colorLocation, glm::vec3(1.0f, 1.0f, 1.0f));
+            mesh_line->draw(shader, visible);
+            glDisable(GL_POLYGON_OFFSET_LINE);
+        }
 
-        glEnable(GL_POLYGON_OFFSET_LINE);
-        glPolygonOffset(-1.0f, -1.0f);  // 负值让线“浮”在表面上
-        shader.setVec3("uColor", glm::vec3(1.0f, 1.0f, 1.0f));
-        mesh_line.draw_line();
-        glDisable(GL_POLYGON_OFFSET_LINE);
+        // 这一帧的深度留给后面的帧做遮挡测试，要在画 gui 之前
+        if (mesh_face && occlusionCulling) occlusion.Capture(framebufferWidth, framebufferHeight, mvp);
         
         // 绘制窗口的gui
-        imgui_draw();
+        imgui_draw(&modelLoad);
 
         time += deltaTime;
         app.swapBuffers();
         app.pollEvents();
+
+        // 没有要画的变化就睡，输入事件的回调、加载线程结束时的空事件或超时把它叫醒
+        if (renderOnDemand && !redraw.NeedsFrame()) {
+            while (!app.shouldClose() && !redraw.NeedsFrame()) {
+                const bool loading = modelLoad.Pending();
+                app.waitEvents(loading ? RedrawScheduler::kLoadingRefreshSeconds : RedrawScheduler::kIdleWaitSeconds);
+                if (loading) redraw.RequestFrame();
+            }
+            lastFrame = float(glfwGetTime());  // 睡着的时间不算进下一帧的 deltaTime
+        }
     }
 
+    // 窗口关了还在加载就让工作线程尽快退出，ModelLoadTask 析构时等它结束
+    modelLoad.Cancel();
     app.terminate();
 
     return 0;
@@ -1039,7 +5033,7 @@ void imgui_init(Application &app) {
 }
 
 
-void imgui_draw() {
+void imgui_draw(ModelLoadTask* loadTask) {
     // 🔧 ImGui 每帧开始
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -1066,6 +5060,18 @@ void imgui_draw() {
         camera.Front = glm::normalize(front);
     }
 
+    ImGui::Checkbox("Render on demand", &renderOnDemand);
+    ImGui::Checkbox("Single-pass wireframe", &singlePassWireframe);
+    ImGui::Checkbox("Frustum culling", &frustumCulling);
+    ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+    ImGui::Text("Visible chunks: %zu / %zu", visibleChunkCount, totalChunkCount);
+    ImGui::Text("Draw submission: %s", DrawSubmitter::IndirectSupported() ? "multi-draw indirect" : "multi-draw");
+    ImGui::Text("Stream buffers: %s", StreamBuffer::PersistentSupported() ? "persistent mapping" : "orphaning");
+    ImGui::Text("Occluded chunks: %zu%s", occludedChunkCount, occlusionCameraCut ? " (camera cut)" : "");
+    ImGui::Checkbox("Level of detail", &levelOfDetail);
+    ImGui::SliderFloat("LOD pixel error", &lodPixelError, 0.25f, 8.0f);
+    ImGui::Text("Triangles: %zu / %zu", drawnTriangleCount, fullTriangleCount);
+
     if (ImGui::Button("Reset Camera Vectors")) {
         camera.Position   = glm::vec3(0.0f, 0.0f, 3.0f);
         camera.Front = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -1077,6 +5083,27 @@ void imgui_draw() {
     // ====================================================================
     ImGui::End();
 
+    // 加载进度面板：加载中显示当前阶段和取消按钮，结束后显示结果
+    if (loadTask) {
+        ImGui::Begin("Model Loading");
+        ImGui::Text("%s", loadTask->Path().c_str());
+
+        const LoadStage stage = loadTask->progress.Stage();
+        if (loadTask->Finished()) {
+            ImGui::Text("%s (%.2f s)", LoadProgress::StageName(stage), loadTask->Elapsed());
+            if (stage == LoadStage::Failed) ImGui::TextWrapped("%s", loadTask->Error().c_str());
+        } else {
+            ImGui::ProgressBar(loadTask->progress.Fraction(), ImVec2(-1.0f, 0.0f), LoadProgress::StageName(stage));
+            ImGui::Text("Elapsed: %.1f s", loadTask->Elapsed());
+            if (loadTask->progress.CancelRequested()) {
+                ImGui::Text("Cancelling...");
+            } else if (ImGui::Button("Cancel")) {
+                loadTask->Cancel();
+            }
+        }
+        ImGui::End();
+    }
+
     // 渲染 ImGui
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());